@@ -8,6 +8,11 @@ test_cpu.o :  $(UTILS)
 multicore_console: $(OBJS)
 	$(CC) $(LFLAGS) $(OBJFOL)multicore_console.o  $(LIBS) -o $(BUILD_FOLDER)multicore_console
 
+convert_console.o :  $(UTILS) 
+	$(CC) $(CFLAGS) $(INCLUDE)  $(FRONTENDFOLDER)convert_console.cpp  -o $(OBJFOL)convert_console.o
+convert_console: convert_console.o
+	$(CC) $(LFLAGS) $(OBJFOL)convert_console.o  $(LIBS) -o $(BUILD_FOLDER)convert_console
+
 test_cpu: test_cpu.o
 	$(CC) $(LFLAGS) $(OBJFOL)test_cpu.o   $(LIBS) -o $(BUILD_FOLDER)test_cpu
 
@@ -19,8 +24,11 @@ test_multicore:
 	./$(BUILD_FOLDER)multicore_console -i datasets/small.csv  -o results/small.txt -v true -d double -f 1 -s 3
 	./$(BUILD_FOLDER)multicore_console -i datasets/small.csv  -o results/small_2.txt -v true -d double -l 1000 -r 64  -f 1 -s 2
 	./$(BUILD_FOLDER)multicore_console -i datasets/small.csv  -o results/small_3.txt -v true -d double -l 1000 -r 64 -u 1 -f 1 -s 2
+	./$(BUILD_FOLDER)convert_console -i datasets/small.csv  -o results/small.bin -d double
+	./$(BUILD_FOLDER)multicore_console -i results/small.bin  -o results/small_4.txt -v true -f 1 -s 3
+	./$(BUILD_FOLDER)multicore_console -i results/small.bin  -o results/small_5.txt -v true -f 1 -s 3 -e 1
 
-multicore: multicore_console test_multicore
+multicore: multicore_console convert_console test_multicore
 
 
 multicore_paper_experiments_batching: KMP
@@ -46,10 +54,35 @@ multicore_paper_experiments_boxplot: KMP
 
 
 multicore_paper_experiments_text_corpora: KMP	
-	$(CC) $(CFLAGS) $(INCLUDE) -I$(MKLROOT)/include $(EXPERIMENTS_FOLDER)experiment_text_corpora.cpp  -o $(OBJFOL)experiment_text_corpora.o 
+	$(CC) $(CFLAGS) $(INCLUDE) $(EXPERIMENTS_FOLDER)experiment_text_corpora.cpp  -o $(OBJFOL)experiment_text_corpora.o 
 	$(CC) $(LFLAGS) $(OBJFOL)experiment_text_corpora.o  $(LIBS) -o $(BUILD_FOLDER)experiment_text_corpora
 	./$(BUILD_FOLDER)experiment_text_corpora	
 
+multicore_paper_experiments_soft_thresholding:
+	$(CC) $(CFLAGS) $(INCLUDE) $(EXPERIMENTS_FOLDER)experiment_soft_thresholding.cpp  -o $(OBJFOL)experiment_soft_thresholding.o 
+	$(CC) $(LFLAGS) $(OBJFOL)experiment_soft_thresholding.o  $(LIBS) -o $(BUILD_FOLDER)experiment_soft_thresholding
+	./$(BUILD_FOLDER)experiment_soft_thresholding
+
+multicore_paper_experiments_starting_points:
+	$(CC) $(CFLAGS) $(INCLUDE) $(EXPERIMENTS_FOLDER)experiment_starting_points.cpp  -o $(OBJFOL)experiment_starting_points.o 
+	$(CC) $(LFLAGS) $(OBJFOL)experiment_starting_points.o  $(LIBS) -o $(BUILD_FOLDER)experiment_starting_points
+	./$(BUILD_FOLDER)experiment_starting_points
+
+multicore_paper_experiments_reduced_precision:
+	$(CC) $(CFLAGS) $(INCLUDE) $(EXPERIMENTS_FOLDER)experiment_reduced_precision.cpp  -o $(OBJFOL)experiment_reduced_precision.o 
+	$(CC) $(LFLAGS) $(OBJFOL)experiment_reduced_precision.o  $(LIBS) -o $(BUILD_FOLDER)experiment_reduced_precision
+	./$(BUILD_FOLDER)experiment_reduced_precision
+
+multicore_paper_experiments_formulations:
+	$(CC) $(CFLAGS) $(INCLUDE) $(EXPERIMENTS_FOLDER)experiment_formulations.cpp  -o $(OBJFOL)experiment_formulations.o 
+	$(CC) $(LFLAGS) $(OBJFOL)experiment_formulations.o  $(LIBS) -o $(BUILD_FOLDER)experiment_formulations
+	./$(BUILD_FOLDER)experiment_formulations
+
+multicore_paper_experiments_threading:
+	$(CC) $(CFLAGS) $(INCLUDE) $(EXPERIMENTS_FOLDER)experiment_threading.cpp  -o $(OBJFOL)experiment_threading.o 
+	$(CC) $(LFLAGS) $(OBJFOL)experiment_threading.o  $(LIBS) -o $(BUILD_FOLDER)experiment_threading
+	./$(BUILD_FOLDER)experiment_threading
+
 
 
 	
@@ -0,0 +1,156 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  Threading of the per-column work of an iteration (norms and signs of Z,
+ *  thresholding of V). It is parallelized on one level only: either across
+ *  the columns (starting points), every column being processed by one thread,
+ *  or within a column, the columns being processed one after another by all
+ *  threads. No parallel region is opened inside another active one.
+ *
+ *  The GEMMs are called outside of parallel regions and use the BLAS threads
+ *  (except the tiles of 16-bit B, see data_matrix.h); set_blas_threads gives
+ *  BLAS the same number of cores as OpenMP.
+ *
+ */
+
+#ifndef EXECUTION_POLICY_H_
+#define EXECUTION_POLICY_H_
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef BLAS_MKL_THREADS
+#include <mkl_service.h>
+#endif
+#ifdef BLAS_OPENBLAS_THREADS
+extern "C" void openblas_set_num_threads(int threads);
+#endif
+
+// a thread within a column gets at least this many entries
+#define EXECUTION_POLICY_MIN_CHUNK 16384
+// cost of a parallel region within a column (in processed entries)
+#define EXECUTION_POLICY_REGION_COST 16384
+// serial selection of the threshold of T_k and S_w (in passes over a column)
+#define EXECUTION_POLICY_SELECTION_COST 2
+
+namespace SolverStructures {
+
+enum ThreadingMode // how the per-column work of an iteration is parallelized
+{
+	AutomaticThreading = 0, // decided by cost model (see ExecutionPolicy::decide)
+	ColumnThreading, // across columns (starting points)
+	VectorThreading // within a column
+};
+
+class ExecutionPolicy {
+public:
+	unsigned int columnThreads; // threads of loops over columns, 0 = all
+	unsigned int vectorThreads; // threads of passes over one column
+
+	ExecutionPolicy() {
+		columnThreads = 0;
+		vectorThreads = 1;
+	}
+
+	static unsigned int cores() {
+#ifdef _OPENMP
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+
+	// number of threads for "num_threads" clause of loops over columns
+	unsigned int threadsAcrossColumns() const {
+		return (columnThreads == 0) ? cores() : columnThreads;
+	}
+
+	// threads for a pass over a column of given length
+	unsigned int threadsWithinVector(const unsigned int length) const {
+		const unsigned int chunks = length / EXECUTION_POLICY_MIN_CHUNK;
+		if (vectorThreads <= 1 || chunks <= 1)
+			return 1;
+		return (chunks < vectorThreads) ? chunks : vectorThreads;
+	}
+
+	/*
+	 * Decision for one iteration of "columns" points with Z of "rows" rows
+	 * and V of "n" rows. Cost model (processed entries): Z takes one pass,
+	 * V one pass (penalized) or three passes and the serial selection of the
+	 * threshold (constrained). Across columns, ceil(columns / cores) rounds
+	 * of one column each; within a column, all columns one after another
+	 * with the parallel passes split into EXECUTION_POLICY_MIN_CHUNK chunks
+	 * and three parallel regions per column.
+	 */
+	void decide(const ThreadingMode mode, const unsigned int columns,
+			const unsigned int rows, const unsigned int n,
+			const bool constrained) {
+		const unsigned int p = cores();
+		columnThreads = p;
+		vectorThreads = 1;
+		if (mode == ColumnThreading || p == 1 || columns == 0)
+			return;
+		if (mode == VectorThreading) {
+			columnThreads = 1;
+			vectorThreads = p;
+			return;
+		}
+		const double parallel = rows + (constrained ? 3.0 : 1.0) * n;
+		const double serial =
+				constrained ? EXECUTION_POLICY_SELECTION_COST * (double) n : 0;
+		const unsigned int acrossThreads = (columns < p) ? columns : p;
+		const double across = (double) ((columns + acrossThreads - 1)
+				/ acrossThreads) * (parallel + serial);
+		unsigned int withinThreads = (unsigned int) (parallel
+				/ EXECUTION_POLICY_MIN_CHUNK);
+		if (withinThreads > p)
+			withinThreads = p;
+		if (withinThreads <= 1)
+			return;
+		const double within = (double) columns
+				* (serial + parallel / withinThreads
+						+ 3 * EXECUTION_POLICY_REGION_COST);
+		if (within < across) {
+			columnThreads = 1;
+			vectorThreads = withinThreads;
+		}
+	}
+};
+
+/*
+ * Start of chunk "chunk" of "chunks" equal parts of [0, length); chunk
+ * "chunks" gives length.
+ */
+inline unsigned int vector_chunk(const unsigned int length,
+		const unsigned int chunks, const unsigned int chunk) {
+	return (unsigned int) ((unsigned long long) length * chunk / chunks);
+}
+
+/*
+ * BLAS threads for the GEMMs (called from serial code only). Builds linked
+ * with MKL or OpenBLAS define BLAS_MKL_THREADS or BLAS_OPENBLAS_THREADS;
+ * the reference CBLAS of GSL is single threaded. Level 1 calls inside the
+ * loops over columns run in one thread (MKL and OpenMP builds of OpenBLAS
+ * do so inside parallel regions).
+ */
+inline void set_blas_threads(const unsigned int threads) {
+	(void) threads;
+#ifdef BLAS_MKL_THREADS
+	mkl_set_num_threads(threads);
+#endif
+#ifdef BLAS_OPENBLAS_THREADS
+	openblas_set_num_threads(threads);
+#endif
+}
+
+}
+#endif /* EXECUTION_POLICY_H_ */
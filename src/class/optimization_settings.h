@@ -22,6 +22,9 @@
 #ifndef optimization_settings_H_
 #define optimization_settings_H_
 
+#include <vector>
+#include "execution_policy.h"
+
 namespace SolverStructures {
 
 enum SPCA_Formulation // Formulation of PCA
@@ -67,6 +70,53 @@ T& operator<<(T& stream, SPCA_Formulation& formulation) {
 	return stream;
 }
 
+/*
+ * Properties of a formulation as compile-time constants. Iterations are
+ * instantiated for every formulation (see dense_solver), so branches on them
+ * are resolved by the compiler instead of testing "formulation" per column.
+ */
+template<SPCA_Formulation formulation>
+class FormulationTraits {
+public:
+	// constraint (T_k or S_w with normalization) instead of penalty
+	static const bool constrained = formulation == L0_constrained_L2_PCA
+			|| formulation == L0_constrained_L1_PCA
+			|| formulation == L1_constrained_L2_PCA
+			|| formulation == L1_constrained_L1_PCA;
+	// L1 sparsity (soft thresholding) instead of L0 (hard thresholding)
+	static const bool L1Sparsity = formulation == L1_constrained_L2_PCA
+			|| formulation == L1_constrained_L1_PCA
+			|| formulation == L1_penalized_L2_PCA
+			|| formulation == L1_penalized_L1_PCA;
+	// z = Bv / \|Bv\|_2 instead of z = sgn(Bv)
+	static const bool L2Problem = formulation == L0_constrained_L2_PCA
+			|| formulation == L1_constrained_L2_PCA
+			|| formulation == L0_penalized_L2_PCA
+			|| formulation == L1_penalized_L2_PCA;
+};
+
+enum StartingPointStrategy // how starting points are generated
+{
+	RandomStartingPoints = 0, // random vectors
+	LargestColumnsStartingPoints, // unit vectors of columns of B with largest norms
+	CombinedColumnsStartingPoints, // random combinations of columns with largest norms
+	SketchStartingPoints // random vectors from sketch B'B*Omega of leading singular subspace
+};
+
+enum StoragePrecision // how dense B is stored by the multicore solver
+{
+	FullPrecisionStorage = 0, // float or double (useDoublePrecision)
+	BFloat16Storage, // bfloat16, computation in float or double
+	Float16Storage // IEEE half precision, computation in float or double
+};
+
+enum GramMatrixMode // whether L2 formulations iterate on G = B'B instead of B
+{
+	AutomaticGramMatrix = 0, // decided by cost model (see use_gram_matrix)
+	NoGramMatrix,
+	UseGramMatrix
+};
+
 //class used to set optimizationSettings to solver
 class OptimizationSettings {
 public:
@@ -74,8 +124,6 @@ public:
 	int distributedRowGridFile; // size of row-grid. used only for distributed solver. See documentation
 	double tolerance; // final toleranceerance for solver
 	bool verbose;
-	bool useSortForHardThresholding; // determines if hardthresholding should be done by sorting (better for large constrain value)
-									 // or by using an sorted map (better for small constrain parameter)
 	bool useKSelectionAlgorithmGPU; // use approximate k-selection algorithm (Russel Steinbach, Jeffrey Blanchard, Bradley Gordon, and Toluwaloju Alabi)
 	bool useDoublePrecision; // determines if one should use "double" or "float"
 	double penaltyParameter; // value of penaltyParameter parameter
@@ -91,7 +139,19 @@ public:
 	int totalStartingPoints; // number of starting points which algorithm should use
 	int batchSize; // size of batch
 	unsigned int totalBatches; // number of bathes - is computer by solver
-	bool useOTF; // on the fly generation - not applicable for distributed solver
+	bool useOTF; // on the fly generation of starting points
+	bool useActiveSet; // constrained formulations: compute B*V only from nonzero rows of V
+	bool useFusedProducts; // dense B: compute B*V and B'z in one pass over B when it pays off (see data_matrix_power_step)
+	bool useSignBitKernel; // dense L1 formulations: z kept only as packed signs of one row panel, B'*sgn(z) by xor/add instead of GEMM (see data_matrix_packed_sign_step)
+	unsigned int seed; // key of the counter based generator of starting points
+	enum StartingPointStrategy startingPointStrategy; // see starting_points.h
+	std::vector<double> pathParameters; // path mode: values of constraintParameter (constrained) or penaltyParameter (penalized) to sweep
+	enum GramMatrixMode gramMatrixMode; // dense L2 formulations: iterate on B'B (see gpower_commons.h)
+	enum StoragePrecision storagePrecision; // multicore console: 16-bit storage of B (see reduced_precision_matrix.h)
+	unsigned int outOfCorePanelMegabytes; // multicore console: read binary B from disk in row panels of this size, 0 maps the whole file (see streamed_matrix.h)
+	bool batchPathParameters; // path mode: solve all values jointly in shared batches instead of warm started sequence
+	enum ThreadingMode threadingMode; // per-column work: across starting points or within a vector (see execution_policy.h)
+	ExecutionPolicy executionPolicy; // is computed by solver in every iteration
 
 	bool doColumnMean;
 	bool doRowMean;
@@ -108,8 +168,17 @@ public:
 		totalStartingPoints = 64;
 		batchSize = 64;
 		doRowMean=false;
-		useSortForHardThresholding = false;
 		useOTF = false;
+		useActiveSet = false;
+		useFusedProducts = true;
+		useSignBitKernel = false; // a tuned BLAS GEMM is as fast or faster on dense B
+		seed = 1;
+		startingPointStrategy = RandomStartingPoints;
+		batchPathParameters = false;
+		gramMatrixMode = AutomaticGramMatrix;
+		storagePrecision = FullPrecisionStorage;
+		outOfCorePanelMegabytes = 0;
+		threadingMode = AutomaticThreading;
 		maximumIterations = 20;
 		getValuesForAllStartingPoints = true;
 		useKSelectionAlgorithmGPU = true;
@@ -142,6 +211,13 @@ public:
 		}
 	}
 
+	bool isL2Problem() {
+		return this->formulation == L0_constrained_L2_PCA
+				|| this->formulation == L1_constrained_L2_PCA
+				|| this->formulation == L0_penalized_L2_PCA
+				|| this->formulation == L1_penalized_L2_PCA;
+	}
+
 	bool isL1PenalizedProblem() {
 		if (this->formulation == L0_penalized_L1_PCA
 				|| this->formulation == L0_penalized_L2_PCA) {
@@ -152,8 +228,13 @@ public:
 
 	}
 
-	// check input optimizationSettings
-	void chceckInputAndModifyIt(unsigned int n) {
+	/*
+	 * check input optimizationSettings; returns false if the problem can not
+	 * be solved (cardinality 0 of a constrained formulation)
+	 */
+	bool chceckInputAndModifyIt(unsigned int n) {
+		if (this->isConstrainedProblem() && this->constraintParameter == 0)
+			return false;
 		if (this->constraintParameter > n) {
 			this->constraintParameter = n;
 		}
@@ -164,7 +245,7 @@ public:
 		if (this->totalBatches * this->batchSize < this->totalStartingPoints)
 			this->totalBatches++;
 		this->totalStartingPoints = this->totalBatches * this->batchSize;
-
+		return true;
 	}
 
 };
@@ -38,9 +38,12 @@ public:
 	std::vector<int> iters; // the same as before, but holds the number of iterations for given starting point
 	std::vector<int> cardinalities; // cardinalities for given starting point. For L0 constrained method doesn't make sense as
 	                                // it's value has to be constrain parameter from optimizationSettings
+	std::vector<double> componentValues; // objective value of every component (solveComponents)
+	double fullPrecisionValue; // reduced precision storage: objective of the solution on full precision B, -1 if not evaluated
 	int totalThreadsUsed;
 	OptimizationStatistics() {
 		it = 0;
+		fullPrecisionValue = -1;
 		totalThreadsUsed=1;
 	}
 };
@@ -0,0 +1,100 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  Dense matrix B (m x n, column-major) stored in 16 bits per entry
+ *  (bfloat16 or fp16, see reduced_precision.h). The solver decodes it in
+ *  tiles into precision F and accumulates in F (see data_matrix.h), so only
+ *  the storage of B (and memory traffic) is reduced.
+ *
+ */
+
+#ifndef REDUCED_PRECISION_MATRIX_H_
+#define REDUCED_PRECISION_MATRIX_H_
+
+#include <vector>
+#include "optimization_settings.h"
+#include "../utils/reduced_precision.h"
+
+namespace SolverStructures {
+
+template<typename F>
+class ReducedPrecisionMatrix {
+public:
+	std::vector<uint16_t> data; // m x n, leading dimension m
+	unsigned int m;
+	unsigned int n;
+	enum StoragePrecision precision; // BFloat16Storage or Float16Storage
+
+	ReducedPrecisionMatrix() {
+		m = 0;
+		n = 0;
+		precision = BFloat16Storage;
+	}
+
+	/*
+	 * Encodes B (leading dimension ldB) with rounding to nearest even.
+	 * Returns 0 on success and 1 if some entry of B is out of range of the
+	 * storage precision (e.g. |b| > 65504 for fp16) or not finite; such an
+	 * entry would be stored as Inf or NaN and B must not be used.
+	 */
+	int store(const F* B, const int ldB, const unsigned int m,
+			const unsigned int n, const enum StoragePrecision precision) {
+		this->m = m;
+		this->n = n;
+		this->precision = precision;
+		data.resize((size_t) m * n);
+		const bool bfloat16 = (precision == BFloat16Storage);
+		// exponent bits of Inf and NaN
+		const uint16_t exponent = bfloat16 ? 0x7F80u : 0x7C00u;
+		int outOfRange = 0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(|:outOfRange)
+#endif
+		for (unsigned int j = 0; j < n; j++) {
+			const F* column = &B[(size_t) ldB * j];
+			uint16_t* out = &data[(size_t) m * j];
+			for (unsigned int i = 0; i < m; i++) {
+				out[i] = bfloat16 ?
+						float_to_bfloat16((float) column[i]) :
+						float_to_float16((float) column[i]);
+				outOfRange |= ((out[i] & exponent) == exponent);
+			}
+		}
+		return outOfRange;
+	}
+
+	// out[0 .. rows) = B[row .. row + rows, column]
+	void decode(const unsigned int row, const unsigned int rows,
+			const unsigned int column, F* out) const {
+		const uint16_t* in = &data[(size_t) m * column + row];
+		if (precision == BFloat16Storage) {
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+			for (unsigned int i = 0; i < rows; i++)
+				out[i] = bfloat16_to_float(in[i]);
+		} else {
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+			for (unsigned int i = 0; i < rows; i++)
+				out[i] = float16_to_float(in[i]);
+		}
+	}
+
+	size_t bytes() const {
+		return data.size() * sizeof(uint16_t);
+	}
+};
+
+}
+#endif /* REDUCED_PRECISION_MATRIX_H_ */
@@ -0,0 +1,95 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  sgn(Z) of the L1 formulations (m x columns, entries -1, 0, 1) packed into
+ *  bits: bit r % 8 of byte r / 8 of a column is set iff z_r < 0, so one byte
+ *  describes 8 rows. Exact zeros (rare for dense data) are listed per column.
+ *  The matrix takes 1 bit per entry instead of sizeof(F) bytes; B'*sgn(Z) is
+ *  computed from it by sign_matrix_multiply (see data_matrix.h). The solver
+ *  keeps one instance in its workspace and packs every row panel of Z into
+ *  it, so memory is reused (see data_matrix_packed_sign_step).
+ *
+ */
+
+#ifndef SIGN_MATRIX_H_
+#define SIGN_MATRIX_H_
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace SolverStructures {
+
+class SignMatrix {
+public:
+	std::vector<uint8_t> bits; // bytesPerColumn x columns
+	std::vector<std::vector<unsigned int> > zeros; // rows with z_r == 0
+	unsigned int m;
+	unsigned int columns;
+	unsigned int bytesPerColumn;
+
+	SignMatrix() {
+		m = 0;
+		columns = 0;
+		bytesPerColumn = 0;
+	}
+
+	/*
+	 * Packs signs of Z (m x columns, leading dimension ldZ); if l1norms is
+	 * given, \|z_j\|_1 is added to l1norms[j] in the same pass.
+	 */
+	template<typename F>
+	void pack(const F* Z, const int ldZ, const unsigned int m,
+			const unsigned int columns, F* l1norms = NULL) {
+		this->m = m;
+		this->columns = columns;
+		bytesPerColumn = (m + 7) / 8;
+		bits.resize((size_t) bytesPerColumn * columns);
+		if (zeros.size() < columns)
+			zeros.resize(columns);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for (unsigned int j = 0; j < columns; j++) {
+			const F* z = &Z[(size_t) ldZ * j];
+			uint8_t* out = &bits[(size_t) bytesPerColumn * j];
+			zeros[j].clear();
+			F norm = 0;
+			for (unsigned int c = 0; c < bytesPerColumn; c++) {
+				const unsigned int rows = (m - 8 * c < 8) ? m - 8 * c : 8;
+				uint8_t byte = 0;
+				for (unsigned int k = 0; k < rows; k++) {
+					const F value = z[8 * c + k];
+					byte |= (uint8_t) ((value < 0) << k);
+					if (value == 0)
+						zeros[j].push_back(8 * c + k);
+					norm += fabs(value);
+				}
+				out[c] = byte;
+			}
+			if (l1norms != NULL)
+				l1norms[j] += norm;
+		}
+	}
+
+	const uint8_t* column(const unsigned int j) const {
+		return &bits[(size_t) bytesPerColumn * j];
+	}
+
+	size_t bytes() const {
+		return bits.size();
+	}
+};
+
+}
+#endif /* SIGN_MATRIX_H_ */
@@ -0,0 +1,227 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *
+ *  Class which owns the working memory of the solvers (Z, V, values and
+ *  thresholding buffers). One instance can be passed to many consecutive
+ *  solver calls; memory is reallocated only if a larger problem comes.
+ *  For constrained formulations it also keeps the active-set (compact)
+ *  representation of V, for L1 formulations the packed signs of Z, for
+ *  sparse data the CSR copy of B, for dense data the Gram matrix B'B and
+ *  final points used as warm starts by the regularization path.
+ *
+ */
+
+#ifndef SOLVER_WORKSPACE_H_
+#define SOLVER_WORKSPACE_H_
+
+#include <stdlib.h>
+#include <new>
+#include <vector>
+#include "../utils/various.h"
+#include "sign_matrix.h"
+
+#define WORKSPACE_ALIGNMENT 64
+
+namespace SolverStructures {
+
+/*
+ * 64-byte aligned array which only grows. New memory is first touched (set to
+ * zero) in parallel, so that on NUMA machines pages are spread over the nodes
+ * of the threads which are going to use them. Content is not preserved when
+ * the array grows.
+ */
+template<typename F>
+class AlignedBuffer {
+public:
+	F* data;
+	size_t capacity;
+
+	AlignedBuffer() {
+		data = NULL;
+		capacity = 0;
+	}
+
+	~AlignedBuffer() {
+		free(data);
+	}
+
+	F* reserve(size_t size) {
+		if (size > capacity) {
+			free(data);
+			data = NULL;
+			capacity = 0;
+			void* memory;
+			if (posix_memalign(&memory, WORKSPACE_ALIGNMENT, size * sizeof(F))
+					!= 0)
+				throw std::bad_alloc();
+			data = (F*) memory;
+			capacity = size;
+			firstTouch();
+		}
+		return data;
+	}
+
+private:
+	void firstTouch() {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+		for (long long i = 0; i < (long long) capacity; i++) {
+			data[i] = 0;
+		}
+	}
+
+	AlignedBuffer(const AlignedBuffer&);
+	AlignedBuffer& operator=(const AlignedBuffer&);
+};
+
+/*
+ * Compact form of V for constrained formulations. Every column of V is stored
+ * as a list of its nonzeros (index, value); Z = B*V is then computed only from
+ * the union of active columns of B, which are gathered into panels of
+ * ACTIVE_SET_PANEL columns.
+ */
+template<typename F>
+class ActiveSetV {
+public:
+	std::vector<std::vector<unsigned int> > indices; // nonzeros of each column of V
+	std::vector<std::vector<F> > values;
+	std::vector<unsigned int> activeColumns; // union of "indices"
+	std::vector<int> position; // position in activeColumns, -1 if not active (length n)
+	AlignedBuffer<F> Bactive; // m x ACTIVE_SET_PANEL gathered columns of B
+	AlignedBuffer<F> Vactive; // ACTIVE_SET_PANEL x experiments gathered rows of V
+
+	void prepare(const unsigned int n, const unsigned int experiments) {
+		if (indices.size() < experiments) {
+			indices.resize(experiments);
+			values.resize(experiments);
+		}
+		for (unsigned int j = 0; j < experiments; j++) {
+			indices[j].clear();
+			values[j].clear();
+		}
+		position.assign(n, -1);
+		activeColumns.clear();
+		activeColumns.reserve(n);
+	}
+
+	// column "from" of V was moved to position "to"
+	void moveColumn(const unsigned int from, const unsigned int to) {
+		indices[to].swap(indices[from]);
+		values[to].swap(values[from]);
+	}
+
+	// stores nonzeros of v (column j of V)
+	void compressColumn(const F* v, const unsigned int n, const unsigned int j) {
+		indices[j].clear();
+		values[j].clear();
+		for (unsigned int i = 0; i < n; i++) {
+			if (v[i] != 0) {
+				indices[j].push_back(i);
+				values[j].push_back(v[i]);
+			}
+		}
+	}
+};
+
+template<typename F>
+class SolverWorkspace {
+public:
+	AlignedBuffer<F> Z; // m x experiments (one panel of rows with packed signs)
+	AlignedBuffer<F> V; // n x experiments
+	AlignedBuffer<F> product; // n x experiments, B'z of fused iterations
+	std::vector<ValueCoordinateHolder<F> > vals; // one per experiment
+	std::vector<std::vector<F> > buffer; // thresholding buffers (length n), one per experiment
+	ActiveSetV<F> activeSet; // used only if optimizationSettings->useActiveSet
+	SignMatrix signs; // used only if optimizationSettings->useSignBitKernel
+	// CSR copy of sparse B (CSC solver), valid for B_CSC_Vals == csrSource
+	// (m x n, nnz nonzeros)
+	std::vector<F> csrVals;
+	std::vector<int> csrColId;
+	std::vector<int> csrRowPtr;
+	const F* csrSource;
+	int csrM;
+	int csrN;
+	int csrNnz;
+	// Gram matrix B'B (n x n) of dense B, valid for B == gramSource (m x n)
+	AlignedBuffer<F> gram;
+	const F* gramSource;
+	unsigned int gramM;
+	unsigned int gramN;
+	/*
+	 * The copies of B above (CSR, Gram matrix) are reused by the next call
+	 * only if sameData is set; a pointer does not tell that B was not
+	 * changed in place. It is set between calls of solvePath and
+	 * solveComponents. A caller which reuses the workspace for unchanged B
+	 * can set it as well and has to call invalidate() when B changes.
+	 */
+	bool sameData;
+	// best final point of every slot (point % batchSize) of the last solve;
+	// with useWarmStart the next solve starts from them (regularization path)
+	AlignedBuffer<F> warmV; // n x batchSize
+	std::vector<F> warmValues; // objective values, -1 if there is no point
+	unsigned int warmN;
+	bool useWarmStart;
+
+	SolverWorkspace() {
+		csrSource = NULL;
+		csrM = 0;
+		csrN = 0;
+		csrNnz = 0;
+		gramSource = NULL;
+		gramM = 0;
+		gramN = 0;
+		sameData = false;
+		warmN = 0;
+		useWarmStart = false;
+	}
+
+	// forgets copies of B, they are formed again by the next call
+	void invalidate() {
+		csrSource = NULL;
+		csrM = 0;
+		csrN = 0;
+		csrNnz = 0;
+		gramSource = NULL;
+		gramM = 0;
+		gramN = 0;
+	}
+
+	/*
+	 * Makes sure there is enough memory for given problem and resets "vals".
+	 * Thresholding buffers are needed only by constrained formulations.
+	 */
+	void prepare(const unsigned int m, const unsigned int n,
+			const unsigned int experiments, const bool needsBuffers) {
+		Z.reserve((size_t) m * experiments);
+		V.reserve((size_t) n * experiments);
+		if (vals.size() < experiments)
+			vals.resize(experiments);
+		for (unsigned int j = 0; j < experiments; j++)
+			vals[j] = ValueCoordinateHolder<F>();
+		if (needsBuffers) {
+			if (buffer.size() < experiments)
+				buffer.resize(experiments);
+			// thresholding uses the size of the buffer, shrinking keeps capacity
+			for (unsigned int j = 0; j < experiments; j++)
+				buffer[j].resize(n);
+		}
+	}
+
+	std::vector<F>* getBuffers() {
+		return buffer.empty() ? NULL : &buffer[0];
+	}
+};
+
+}
+#endif /* SOLVER_WORKSPACE_H_ */
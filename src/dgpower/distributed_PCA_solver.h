@@ -11,8 +11,9 @@
  * under GNU GPL v3 License
  * 
  *
- *  This file contains a distributed solver. The solver works only for dense matrices
- *  and doesn't have implemented on the fly strategy and batching with more than one batch.
+ *  This file contains a distributed solver. The solver works only for dense matrices.
+ *  Starting points are processed in slots of "batchSize" columns of V and Z, either
+ *  batch after batch or with on the fly refilling of slots (useOTF).
  *
  */
 
@@ -28,12 +29,71 @@
 #include "../utils/termination_criteria.h"
 #include "../utils/thresh_functions.h"
 #include "../utils/various.h"
+#include "../utils/counter_rng.h"
 #include "distributed_classes.h"
 #include "distributed_thresholdings.h"
 
 namespace SPCASolver {
 namespace DistributedSolver {
 
+/*
+ * Generates starting point "points[c]" into every slot "c" with points[c] >= 0.
+ * Every node generates its own rows of the column (element of the counter
+ * based stream "point" given by global row), so no communication is needed
+ * and starting points do not depend on the process grid.
+ */
+template<typename F>
+void generate_distributed_starting_points(
+		SPCASolver::DistributedClasses::OptimizationData<F>& optimizationDataInstance,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		const std::vector<int>& points) {
+	for (int i = 0; i < optimizationDataInstance.V_nq; i++) {
+		const int slot = get_column_coordinate(i,
+				optimizationDataInstance.params.mycol,
+				optimizationDataInstance.params.npcol,
+				optimizationDataInstance.params.x_vector_blocking);
+		if (points[slot] < 0)
+			continue;
+		const int blocking = optimizationDataInstance.params.x_vector_blocking;
+		for (int j = 0; j < optimizationDataInstance.V_mp; j += blocking) {
+			const int rows =
+					(optimizationDataInstance.V_mp - j < blocking) ?
+							optimizationDataInstance.V_mp - j : blocking;
+			counter_rng_fill_uniform(
+					&optimizationDataInstance.V[j
+							+ i * optimizationDataInstance.V_mp], rows, (F) -1,
+					(F) 1, optimizationSettings->seed, points[slot],
+					get_column_coordinate(j,
+							optimizationDataInstance.params.myrow,
+							optimizationDataInstance.params.nprow, blocking));
+		}
+	}
+}
+
+/*
+ * Number of nonzeros in every column (slot) of V, summed over the grid
+ */
+template<typename F>
+void get_distributed_cardinalities(
+		SPCASolver::DistributedClasses::OptimizationData<F>& optimizationDataInstance,
+		MKL_INT slots, std::vector<MKL_INT>& cardinalities) {
+	cardinalities.assign(slots, 0);
+	for (int i = 0; i < optimizationDataInstance.V_nq; i++) {
+		const int slot = get_column_coordinate(i,
+				optimizationDataInstance.params.mycol,
+				optimizationDataInstance.params.npcol,
+				optimizationDataInstance.params.x_vector_blocking);
+		for (int j = 0; j < optimizationDataInstance.V_mp; j++) {
+			if (optimizationDataInstance.V[j + i * optimizationDataInstance.V_mp]
+					!= 0)
+				cardinalities[slot]++;
+		}
+	}
+	igsum2d_(&optimizationDataInstance.params.ictxt, &C_CHAR_SCOPE_ALL,
+			&C_CHAR_GENERAL_TREE_CATHER, &slots, &i_one, &cardinalities[0],
+			&slots, &i_negone, &i_negone);
+}
+
 template<typename F>
 void denseDataSolver(
 		SPCASolver::DistributedClasses::OptimizationData<F>& optimizationDataInstance,
@@ -49,7 +109,12 @@ void denseDataSolver(
 	if (optimizationSettings->verbose && optimizationSettings->proccessNode == 0) {
 		std::cout << "Solver started " << std::endl;
 	}
-	optimizationSettings->chceckInputAndModifyIt(N);
+	if (!optimizationSettings->chceckInputAndModifyIt(N)) {
+		// same decision on all nodes
+		optimizationStatistics->it = 0;
+		optimizationStatistics->fval = -1;
+		return;
+	}
 	optimizationStatistics->it = optimizationSettings->maximumIterations;
 	// Allocate vector for optimizationStatistics to return which point needs how much iterations
 	if (optimizationSettings->storeIterationsForAllPoints) {
@@ -59,7 +124,6 @@ void denseDataSolver(
 
 	}
 	const unsigned int number_of_experiments_per_batch = optimizationSettings->batchSize;
-	// TODO implement on the fly and other strategies...
 
 	F* B = &optimizationDataInstance.B[0];
 	F* x = &optimizationDataInstance.x[0];
@@ -74,7 +138,6 @@ void denseDataSolver(
 	optimizationDataInstance.z_nq = numroc_(&optimizationSettings->batchSize, &ROW_BLOCKING,
 			&mycol, &i_zero, &npcol);
 
-	unsigned int seed = mycol * nprow + myrow;
 	optimizationDataInstance.nnz_z = optimizationDataInstance.z_mp
 			* optimizationDataInstance.z_nq;
 	optimizationDataInstance.Z = (F*) calloc(optimizationDataInstance.nnz_z,
@@ -96,13 +159,6 @@ void denseDataSolver(
 			* optimizationDataInstance.V_nq;
 	optimizationDataInstance.V = (F*) calloc(optimizationDataInstance.nnz_v,
 			sizeof(F));
-	for (i = 0; i < optimizationDataInstance.nnz_v; i++) {
-		optimizationDataInstance.V[i] = -1 + 2 * (F) rand_r(&seed) / RAND_MAX;
-	}
-	// initial thresholding of matrix "V".....
-	if (optimizationSettings->isConstrainedProblem()) {
-		SPCASolver::distributed_thresholdings::threshold_V_for_constrained(optimizationDataInstance, optimizationSettings, optimizationStatistics);
-	}
 
 	//=============== Create description for "x"
 	MKL_INT x_mp = numroc_(&N, &X_VECTOR_BLOCKING, &myrow, &i_zero, &nprow);
@@ -112,16 +168,56 @@ void denseDataSolver(
 	i_tmp1 = MAX(1, x_mp);
 	descinit_(desc_x, &N, &i_one, &X_VECTOR_BLOCKING, &X_VECTOR_BLOCKING,
 			&i_zero, &i_zero, &ictxt, &i_tmp1, &info);
-	//=============== Create vector for "norms"
-	optimizationDataInstance.norms = (F*) calloc(optimizationSettings->totalStartingPoints,
+	//=============== Create vector for "norms" (one value per slot)
+	optimizationDataInstance.norms = (F*) calloc(number_of_experiments_per_batch,
 			sizeof(F));
-	std::vector<ValueCoordinateHolder<F> > values(optimizationSettings->totalStartingPoints);
+	/*
+	 * Slot "c" (column of V and Z) holds starting point slot_point[c], or -1 if
+	 * it is free. Objective values are summed over the grid, hence all nodes
+	 * take the same decisions about retiring and refilling slots.
+	 */
+	std::vector<ValueCoordinateHolder<F> > values(number_of_experiments_per_batch);
+	std::vector<int> slot_point(number_of_experiments_per_batch, -1);
+	std::vector<unsigned int> slot_iteration(number_of_experiments_per_batch, 0);
+	std::vector<int> new_points(number_of_experiments_per_batch, -1);
+	std::vector<MKL_INT> cardinalities;
+	int generated_points = 0;
+	int live = 0;
+	optimizationStatistics->fval = -1;
 	// ======================== RUN SOLVER
 	optimizationStatistics->it = 0;
-	double fval = 0;
-	double fval_prev = 0;
-	unsigned int it;
-	for (it = 0; it < optimizationSettings->maximumIterations; it++) {
+	while (true) {
+		//=============== fill free slots with new starting points
+		if (optimizationSettings->useOTF || live == 0) {
+			bool generated = false;
+			for (unsigned int slot = 0; slot < number_of_experiments_per_batch;
+					slot++) {
+				new_points[slot] = -1;
+				if (slot_point[slot] < 0
+						&& generated_points
+								< optimizationSettings->totalStartingPoints) {
+					new_points[slot] = generated_points;
+					slot_point[slot] = generated_points;
+					slot_iteration[slot] = 0;
+					values[slot].reset();
+					generated_points++;
+					live++;
+					generated = true;
+				}
+			}
+			if (generated) {
+				generate_distributed_starting_points(optimizationDataInstance,
+						optimizationSettings, new_points);
+				// thresholding is idempotent for already thresholded columns
+				if (optimizationSettings->isConstrainedProblem()) {
+					SPCASolver::distributed_thresholdings::threshold_V_for_constrained(
+							optimizationDataInstance, optimizationSettings,
+							optimizationStatistics);
+				}
+			}
+		}
+		if (live == 0)
+			break;
 		optimizationStatistics->it++;
 		if (optimizationSettings->isConstrainedProblem()) {
 			SPCASolver::distributed_thresholdings::perform_one_distributed_iteration_for_constrained_pca(
@@ -132,11 +228,16 @@ void denseDataSolver(
 		}
 		//Agregate FVAL
 		Xgsum2d(&ictxt, &C_CHAR_SCOPE_ALL, &C_CHAR_GENERAL_TREE_CATHER,
-				&optimizationSettings->totalStartingPoints, &i_one,
-				optimizationDataInstance.norms, &optimizationSettings->totalStartingPoints,
+				&optimizationSettings->batchSize, &i_one,
+				optimizationDataInstance.norms, &optimizationSettings->batchSize,
 				&i_negone, &i_negone);
-		double max_error = 0;
-		for (i = 0; i < optimizationSettings->totalStartingPoints; i++) {
+		std::vector<bool> converged(number_of_experiments_per_batch, false);
+		std::vector<bool> retired(number_of_experiments_per_batch, false);
+		bool anyConverged = false;
+		for (unsigned int slot = 0; slot < number_of_experiments_per_batch;
+				slot++) {
+			if (slot_point[slot] < 0)
+				continue;
 			if (optimizationSettings->formulation == SolverStructures::L0_penalized_L1_PCA
 					|| optimizationSettings->formulation
 							== SolverStructures::L0_penalized_L2_PCA
@@ -144,38 +245,56 @@ void denseDataSolver(
 							== SolverStructures::L0_constrained_L1_PCA
 					|| optimizationSettings->formulation
 							== SolverStructures::L1_constrained_L1_PCA) {
-				values[i].val = optimizationDataInstance.norms[i];
+				values[slot].val = optimizationDataInstance.norms[slot];
 			} else {
-				values[i].val = sqrt(optimizationDataInstance.norms[i]);
+				values[slot].val = sqrt(optimizationDataInstance.norms[slot]);
 			}
+			const unsigned int it = slot_iteration[slot];
 			if (it > 0) {
-				double tmp_error = computeTheError(values[i].val,
-						values[i].prev_val, optimizationSettings);
-				if (tmp_error > max_error)
-					max_error = tmp_error;
+				values[slot].current_error = computeTheError(values[slot].val,
+						values[slot].prev_val, optimizationSettings);
+				converged[slot] = termination_criteria(
+						values[slot].current_error, it, optimizationSettings);
 			}
-			values[i].prev_val = values[i].val;
+			values[slot].prev_val = values[slot].val;
+			retired[slot] = converged[slot]
+					|| it + 1 >= optimizationSettings->maximumIterations;
+			anyConverged = anyConverged || converged[slot];
+			slot_iteration[slot] = it + 1;
 		}
-
-		if (it > 0 && termination_criteria(max_error, it, optimizationSettings)) { //FIXME CHECK
-			break;
+		if (anyConverged && optimizationSettings->storeIterationsForAllPoints) {
+			get_distributed_cardinalities(optimizationDataInstance,
+					optimizationSettings->batchSize, cardinalities);
 		}
-	}
-
-	optimizationStatistics->fval = -1;
-	int max_selection_idx = -1;
-	for (i = 0; i < optimizationSettings->totalStartingPoints; i++) {
-		if (values[i].val > optimizationStatistics->fval) {
-			max_selection_idx = i;
-			optimizationStatistics->fval = values[i].val;
+		//=============== retire points, keep the best one in "x"
+		for (unsigned int slot = 0; slot < number_of_experiments_per_batch;
+				slot++) {
+			if (!retired[slot])
+				continue;
+			const int point = slot_point[slot];
+			if (optimizationSettings->storeIterationsForAllPoints) {
+				optimizationStatistics->values[point] = values[slot].val;
+				if (converged[slot]) {
+					optimizationStatistics->iters[point] =
+							slot_iteration[slot] - 1;
+					optimizationStatistics->cardinalities[point] =
+							cardinalities[slot];
+				}
+			}
+			if (values[slot].val > optimizationStatistics->fval) {
+				optimizationStatistics->fval = values[slot].val;
+				//copy column "slot" from matrix V into vector x!
+				//	sub(C):=beta*sub(C) + alpha*op(sub(A)),
+				MKL_INT column = slot + 1;	// because next fucntion use 1-based
+				pXgeadd(&transNo, &N, &i_one, &one, optimizationDataInstance.V,
+						&i_one, &column, optimizationDataInstance.descV, &zero,
+						x, &i_one, &i_one, desc_x);
+			}
+			slot_point[slot] = -1;
+			live--;
 		}
 	}
-	//copy "MAX_SELECTION_IDX" column from matrix V into vector x!
-	//	sub(C):=beta*sub(C) + alpha*op(sub(A)),
-	max_selection_idx++;	// because next fucntion use 1-based
-	pXgeadd(&transNo, &N, &i_one, &one, optimizationDataInstance.V, &i_one,
-			&max_selection_idx, optimizationDataInstance.descV, &zero, x, &i_one,
-			&i_one, desc_x);
+
 	//============== COMPUTE final "x"
 	F norm_of_x = 0;
 	pXnrm2(&N, &norm_of_x, x, &i_one, &i_one, desc_x, &i_one);
@@ -104,7 +104,7 @@ void perform_one_distributed_iteration_for_penalized_pca(
 			optimizationDataInstance.V, &i_one, &i_one,
 			optimizationDataInstance.descV);
 	// perform thresh-holding operations and compute objective values
-	clear_local_vector(optimizationDataInstance.norms, optimizationSettings->totalStartingPoints); // we use NORMS to store objective values
+	clear_local_vector(optimizationDataInstance.norms, optimizationSettings->batchSize); // we use NORMS to store objective values
 	if (optimizationSettings->formulation == SolverStructures::L0_penalized_L1_PCA
 			|| optimizationSettings->formulation == SolverStructures::L0_penalized_L2_PCA) {
 		for (int i = 0; i < optimizationDataInstance.V_nq; i++) {
@@ -176,7 +176,6 @@ void threshold_V_for_constrained(
 								optimizationDataInstance.V_constr_sort_buffer[j],
 								optimizationSettings); // x = S_w(x)
 			} else {
-				optimizationSettings->useSortForHardThresholding = true;
 				norm_of_x =
 						k_hard_thresholding(
 								&optimizationDataInstance.V_constr_threshold[optimizationDataInstance.params.DIM_N
@@ -0,0 +1,85 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *    CONVERTER CSV -> BINARY MATRIX FORMAT - frontend console interface
+ *
+ *    Usage: convert_console -i input.csv -o output.bin [-d double] [-a alignment]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../class/optimization_settings.h"
+#include "../class/optimization_statistics.h"
+using namespace SolverStructures;
+#include "../utils/file_reader.h"
+#include "../utils/binary_matrix_file.h"
+
+template<typename F>
+int convert(const char* inputFilePath, const char* outputFilePath,
+		unsigned int alignment) {
+	std::vector<F> B_mat;
+	unsigned int ldB, m, n;
+	int status = InputOuputHelper::readCSVFile(B_mat, ldB, m, n,
+			inputFilePath);
+	if (status == 2) {
+		printf("File %s is not a CSV matrix (rows of different length or values which are not numbers)\n",
+				inputFilePath);
+		return 1;
+	}
+	if (status != 0 || B_mat.empty()) {
+		printf("Cannot read file %s\n", inputFilePath);
+		return 1;
+	}
+	status = InputOuputHelper::write_binary_matrix_file(outputFilePath,
+			&B_mat[0], ldB, m, n, alignment);
+	if (status != 0) {
+		printf("Cannot write file %s\n", outputFilePath);
+		return status;
+	}
+	printf("Stored %d x %d matrix into %s\n", m, n, outputFilePath);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	char* inputFilePath = NULL;
+	char* outputFilePath = NULL;
+	bool useDoublePrecision = false;
+	unsigned int alignment = BINARY_MATRIX_DEFAULT_ALIGNMENT;
+	char c;
+	while ((c = getopt(argc, argv, "i:o:d:a:")) != -1) {
+		switch (c) {
+		case 'i':
+			inputFilePath = optarg;
+			break;
+		case 'o':
+			outputFilePath = optarg;
+			break;
+		case 'd':
+			useDoublePrecision = true;
+			break;
+		case 'a':
+			alignment = atoi(optarg);
+			break;
+		}
+	}
+	if (inputFilePath == NULL || outputFilePath == NULL) {
+		printf("Usage: convert_console -i input.csv -o output.bin [-d double] [-a alignment]\n");
+		return 1;
+	}
+	if (useDoublePrecision) {
+		return convert<double>(inputFilePath, outputFilePath, alignment);
+	} else {
+		return convert<float>(inputFilePath, outputFilePath, alignment);
+	}
+}
@@ -19,21 +19,172 @@
 using namespace SolverStructures;
 #include "../gpower/sparse_PCA_solver.h"
 #include "../utils/file_reader.h"
+#include "../utils/binary_matrix_file.h"
+#include "../utils/streamed_matrix.h"
 #include "../utils/option_console_parser.h"
 
+/*
+ * Regularization path: one solve per value of "-w" (or one joint solve with
+ * "-j 1"), results of value i are stored into files with prefix "<output>_<i>"
+ */
+template<typename F>
+void run_path_solver(OptimizationSettings* optimizationSettings, const F* B,
+		const unsigned int ldB, const unsigned int m, const unsigned int n,
+		double start_wall_time) {
+	const std::vector<double>& parameters = optimizationSettings->pathParameters;
+	std::vector<F> X((size_t) n * parameters.size(), 0);
+	std::vector<OptimizationStatistics> statistics;
+	if (optimizationSettings->batchPathParameters) {
+		SPCASolver::MulticoreSolver::solveParameterBatch(B, ldB, &X[0], m, n,
+				parameters, optimizationSettings, statistics);
+	} else {
+		SPCASolver::MulticoreSolver::solvePath(B, ldB, &X[0], m, n, parameters,
+				optimizationSettings, statistics);
+	}
+	for (unsigned int i = 0; i < parameters.size(); i++) {
+		if (statistics[i].fval < 0) {
+			printf("Cannot solve for value %g of \"-w\" (cardinality has to be at least 1)\n",
+					parameters[i]);
+			exit(1);
+		}
+	}
+	double end_wall_time = gettime();
+	char* outputFilePath = optimizationSettings->outputFilePath;
+	const unsigned int constraintParameter =
+			optimizationSettings->constraintParameter;
+	const double penaltyParameter = optimizationSettings->penaltyParameter;
+	for (unsigned int i = 0; i < parameters.size(); i++) {
+		std::stringstream ss;
+		ss << i;
+		optimizationSettings->outputFilePath = InputOuputHelper::get_file_modified_name(
+				outputFilePath, ss.str());
+		if (optimizationSettings->isConstrainedProblem())
+			optimizationSettings->constraintParameter = (unsigned int) parameters[i];
+		else
+			optimizationSettings->penaltyParameter = parameters[i];
+		statistics[i].n = n;
+		statistics[i].totalElapsedTime = end_wall_time - start_wall_time;
+		InputOuputHelper::save_results(&statistics[i], optimizationSettings,
+				&X[(size_t) n * i], n);
+		InputOuputHelper::saveSolverStatistics(&statistics[i], optimizationSettings);
+		delete[] optimizationSettings->outputFilePath;
+	}
+	optimizationSettings->outputFilePath = outputFilePath;
+	optimizationSettings->constraintParameter = constraintParameter;
+	optimizationSettings->penaltyParameter = penaltyParameter;
+}
+
+/*
+ * Out-of-core mode ("-e"): binary B is not mapped but read in row panels
+ * during every iteration
+ */
+template<typename F>
+void run_streamed_solver(OptimizationSettings* optimizationSettings,
+		double start_wall_time) {
+	InputOuputHelper::StreamedMatrix<F> B;
+	int status = B.open(optimizationSettings->inputFilePath,
+			(unsigned long long) optimizationSettings->outOfCorePanelMegabytes
+					<< 20);
+	if (status != 0) {
+		printf("Cannot open binary file %s (error %d)\n", optimizationSettings->inputFilePath, status);
+		exit(1);
+	}
+	OptimizationStatistics* optimizationStatistics = new OptimizationStatistics();
+	optimizationStatistics->n = B.n;
+	std::vector<F> x_vec(B.n, 0);
+	if (SPCASolver::MulticoreSolver::streamedDataSolver(B, &x_vec[0],
+			optimizationSettings, optimizationStatistics) < 0) {
+		printf("Cannot read binary file %s\n", optimizationSettings->inputFilePath);
+		exit(1);
+	}
+	double end_wall_time = gettime();
+	optimizationStatistics->totalElapsedTime = end_wall_time - start_wall_time;
+	if (optimizationSettings->verbose) {
+		printf("Read %.1f MB in %u panels of %u rows, %f s waiting for disk\n",
+				B.bytesRead / 1048576.0, B.panels, B.panelRows, B.waitTime);
+	}
+	InputOuputHelper::save_results(optimizationStatistics, optimizationSettings, &x_vec[0], B.n);
+	InputOuputHelper::saveSolverStatistics(optimizationStatistics, optimizationSettings);
+}
+
 template<typename F>
 void load_data_and_run_solver(OptimizationSettings* optimizationSettings) {
 	double start_wall_time = gettime();
+	if (optimizationSettings->outOfCorePanelMegabytes > 0) {
+		if (!InputOuputHelper::is_binary_matrix_file(optimizationSettings->inputFilePath)) {
+			printf("Warning: \"-e\" needs a binary file, %s is loaded into memory\n",
+					optimizationSettings->inputFilePath);
+		} else if (!optimizationSettings->pathParameters.empty()) {
+			printf("Warning: \"-e\" is not supported with \"-w\", %s is mapped into memory\n",
+					optimizationSettings->inputFilePath);
+		} else {
+			if (optimizationSettings->storagePrecision != FullPrecisionStorage)
+				printf("Warning: \"-h\" is not supported with \"-e\", B is stored in full precision\n");
+			run_streamed_solver<F>(optimizationSettings, start_wall_time);
+			return;
+		}
+	}
 	std::vector<F> B_mat;
+	InputOuputHelper::MappedMatrix<F> B_mapped;
+	const F* B;
 	unsigned int ldB, m, n;
-	// load data from CSV file
-	InputOuputHelper::readCSVFile(B_mat, ldB, m, n, optimizationSettings->inputFilePath);
+	if (InputOuputHelper::is_binary_matrix_file(optimizationSettings->inputFilePath)) {
+		// map binary file, data are used in place
+		int status = B_mapped.map(optimizationSettings->inputFilePath);
+		if (status != 0) {
+			printf("Cannot map binary file %s (error %d)\n", optimizationSettings->inputFilePath, status);
+			exit(1);
+		}
+		B = B_mapped.data;
+		ldB = B_mapped.ldB;
+		m = B_mapped.m;
+		n = B_mapped.n;
+	} else {
+		// load data from CSV file
+		int status = InputOuputHelper::readCSVFile(B_mat, ldB, m, n, optimizationSettings->inputFilePath);
+		if (status == 2) {
+			printf("File %s is not a CSV matrix (rows of different length or values which are not numbers)\n", optimizationSettings->inputFilePath);
+			exit(1);
+		}
+		if (status != 0) {
+			printf("Cannot read file %s\n", optimizationSettings->inputFilePath);
+			exit(1);
+		}
+		B = &B_mat[0];
+	}
+	if (!optimizationSettings->pathParameters.empty()) {
+		run_path_solver(optimizationSettings, B, ldB, m, n, start_wall_time);
+		return;
+	}
 	OptimizationStatistics* optimizationStatistics = new OptimizationStatistics();
 	optimizationStatistics->n = n;
 	std::vector<F> x_vec(n, 0);
 	// run SOLVER
-	SPCASolver::MulticoreSolver::denseDataSolver(&B_mat[0], ldB, &x_vec[0], m, n, optimizationSettings,
-			optimizationStatistics);
+	if (optimizationSettings->storagePrecision != FullPrecisionStorage) {
+		SolverStructures::ReducedPrecisionMatrix<F> B_reduced;
+		if (B_reduced.store(B, ldB, m, n,
+				optimizationSettings->storagePrecision) != 0) {
+			printf("Data in %s are out of range of %s storage, use \"-h 0\"%s\n",
+					optimizationSettings->inputFilePath,
+					(optimizationSettings->storagePrecision == Float16Storage) ?
+							"fp16" : "bfloat16",
+					(optimizationSettings->storagePrecision == Float16Storage) ?
+							" or \"-h 1\" (bfloat16)" : "");
+			exit(1);
+		}
+		// parsed CSV data are not needed any more, mapped data stay on disk
+		std::vector<F>().swap(B_mat);
+		SPCASolver::MulticoreSolver::reducedPrecisionSolver(B_reduced, &x_vec[0],
+				optimizationSettings, optimizationStatistics);
+		// solution is evaluated on full precision B only if it is mapped
+		if (B_mapped.data != NULL)
+			optimizationStatistics->fullPrecisionValue =
+					SPCASolver::MulticoreSolver::evaluateSolution(B, ldB,
+							&x_vec[0], m, n, optimizationSettings);
+	} else {
+		SPCASolver::MulticoreSolver::denseDataSolver(B, ldB, &x_vec[0], m, n,
+				optimizationSettings, optimizationStatistics);
+	}
 	double end_wall_time = gettime();
 	optimizationStatistics->totalElapsedTime = end_wall_time - start_wall_time;
     // store result into file
@@ -47,6 +198,11 @@ int main(int argc, char *argv[]) {
 	int optimizationStatisticsus = parseConsoleOptions(optimizationSettings, argc, argv);
 	if (optimizationStatisticsus > 0)
 		return optimizationStatisticsus;
+	InputOuputHelper::BinaryMatrixHeader header;
+	if (InputOuputHelper::read_binary_matrix_header(optimizationSettings->inputFilePath, header) == 0) {
+		// precision of binary file wins over "-d"
+		optimizationSettings->useDoublePrecision = (header.precision == sizeof(double));
+	}
 	if (optimizationSettings->useDoublePrecision) {
 		load_data_and_run_solver<double>(optimizationSettings);
 	} else {
@@ -0,0 +1,462 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  Operations of the dense solver on data matrix B. B is either a plain
+ *  column-major array (BLAS) or ReducedPrecisionMatrix, which is decoded in
+ *  tiles of REDUCED_PRECISION_TILE_ROWS x REDUCED_PRECISION_TILE_COLUMNS
+ *  (small enough to stay in cache) and every tile is multiplied by BLAS in
+ *  precision F, so products are accumulated in F. Out-of-core B
+ *  (StreamedMatrix) is read in row panels; an iteration of the solver needs
+ *  only one pass over it (see data_matrix_power_step). For L1 formulations
+ *  Z can be kept only as packed signs of one row panel and B'*sgn(Z) is
+ *  computed from them (see data_matrix_packed_sign_step).
+ *
+ */
+
+#ifndef DATA_MATRIX_H_
+#define DATA_MATRIX_H_
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+#include "../class/reduced_precision_matrix.h"
+#include "../class/sign_matrix.h"
+#include "../utils/my_cblas_wrapper.h"
+#include "../utils/openmp_helper.h"
+#include "../utils/streamed_matrix.h"
+#include "../utils/thresh_functions.h"
+
+#define REDUCED_PRECISION_TILE_ROWS 1024
+#define REDUCED_PRECISION_TILE_COLUMNS 64
+
+/*
+ * Y = B*X (CblasNoTrans; X is n x experiments, Y is m x experiments) or
+ * Y = B'*X (CblasTrans; X is m x experiments, Y is n x experiments)
+ */
+template<typename F>
+void data_matrix_multiply(const CBLAS_TRANSPOSE trans, const unsigned int m,
+		const unsigned int n, const unsigned int experiments, const F* B,
+		const int ldB, const F* X, const int ldX, F* Y, const int ldY) {
+	if (trans == CblasNoTrans) {
+		cblas_matrix_matrix_multiply(CblasColMajor, CblasNoTrans, CblasNoTrans,
+				m, experiments, n, 1, B, ldB, X, ldX, 0, Y, ldY);
+	} else {
+		cblas_matrix_matrix_multiply(CblasColMajor, CblasTrans, CblasNoTrans,
+				n, experiments, m, 1, B, ldB, X, ldX, 0, Y, ldY);
+	}
+}
+
+// column j of B (length m); "buffer" is used only if B has to be decoded
+template<typename F>
+const F* data_matrix_column(const F* B, const int ldB, const unsigned int,
+		const unsigned int j, F*) {
+	return &B[(size_t) ldB * j];
+}
+
+/*
+ * The same for 16-bit storage (ldB is not used). Z = B*X is parallel over
+ * blocks of rows of Z, V = B'*X over blocks of rows of V, so threads never
+ * write to the same memory. The GEMMs of the tiles run inside the parallel
+ * region, so BLAS gets one thread until it ends.
+ */
+template<typename F>
+void data_matrix_multiply(const CBLAS_TRANSPOSE trans, const unsigned int m,
+		const unsigned int n, const unsigned int experiments,
+		const SolverStructures::ReducedPrecisionMatrix<F>* B, const int,
+		const F* X, const int ldX, F* Y, const int ldY) {
+	unsigned int tileRows = REDUCED_PRECISION_TILE_ROWS;
+	if (trans == CblasNoTrans) {
+		// enough blocks of rows for all threads
+		unsigned int threads = 1;
+#ifdef _OPENMP
+		threads = omp_get_max_threads();
+#endif
+		tileRows = std::max(64u,
+				std::min(tileRows, (m + threads - 1) / threads));
+	}
+	const unsigned int tileColumns = REDUCED_PRECISION_TILE_COLUMNS;
+	const unsigned int blocks =
+			(trans == CblasNoTrans) ?
+					(m + tileRows - 1) / tileRows :
+					(n + tileColumns - 1) / tileColumns;
+	SolverStructures::set_blas_threads(1);
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+	{
+		std::vector<F> tile((size_t) tileRows * tileColumns);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+		for (unsigned int block = 0; block < blocks; block++) {
+			const unsigned int firstRow =
+					(trans == CblasNoTrans) ? block * tileRows : 0;
+			const unsigned int lastRow =
+					(trans == CblasNoTrans) ?
+							std::min(m, firstRow + tileRows) : m;
+			const unsigned int firstColumn =
+					(trans == CblasNoTrans) ? 0 : block * tileColumns;
+			const unsigned int lastColumn =
+					(trans == CblasNoTrans) ?
+							n : std::min(n, firstColumn + tileColumns);
+			for (unsigned int column = firstColumn; column < lastColumn;
+					column += tileColumns) {
+				const unsigned int columns = std::min(tileColumns,
+						lastColumn - column);
+				for (unsigned int row = firstRow; row < lastRow; row +=
+						tileRows) {
+					const unsigned int rows = std::min(tileRows, lastRow - row);
+					for (unsigned int c = 0; c < columns; c++)
+						B->decode(row, rows, column + c, &tile[(size_t) rows * c]);
+					if (trans == CblasNoTrans) {
+						cblas_matrix_matrix_multiply(CblasColMajor, CblasNoTrans,
+								CblasNoTrans, rows, experiments, columns, 1,
+								&tile[0], rows, &X[column], ldX,
+								(column == 0) ? 0 : 1, &Y[row], ldY);
+					} else {
+						cblas_matrix_matrix_multiply(CblasColMajor, CblasTrans,
+								CblasNoTrans, columns, experiments, rows, 1,
+								&tile[0], rows, &X[row], ldX, (row == 0) ? 0 : 1,
+								&Y[column], ldY);
+					}
+				}
+			}
+		}
+	}
+	SolverStructures::set_blas_threads(
+			SolverStructures::ExecutionPolicy::cores());
+}
+
+template<typename F>
+const F* data_matrix_column(
+		const SolverStructures::ReducedPrecisionMatrix<F>* B, const int,
+		const unsigned int m, const unsigned int j, F* buffer) {
+	B->decode(0, m, j, buffer);
+	return buffer;
+}
+
+/*
+ * The same for out-of-core B; every call is one pass over the file (ldB is
+ * not used).
+ */
+template<typename F>
+void data_matrix_multiply(const CBLAS_TRANSPOSE trans, const unsigned int,
+		const unsigned int n, const unsigned int experiments,
+		const InputOuputHelper::StreamedMatrix<F>* B, const int,
+		const F* X, const int ldX, F* Y, const int ldY) {
+	for (unsigned int p = 0; p < B->panels; p++) {
+		const F* panel = B->panel(p);
+		const unsigned int row = p * B->panelRows;
+		const unsigned int rows = B->rowsOfPanel(p);
+		if (trans == CblasNoTrans) {
+			cblas_matrix_matrix_multiply(CblasColMajor, CblasNoTrans,
+					CblasNoTrans, rows, experiments, n, 1, panel, rows, X, ldX,
+					0, &Y[row], ldY);
+		} else {
+			cblas_matrix_matrix_multiply(CblasColMajor, CblasTrans,
+					CblasNoTrans, n, experiments, rows, 1, panel, rows,
+					&X[row], ldX, (p == 0) ? 0 : 1, Y, ldY);
+		}
+	}
+}
+
+template<typename F>
+const F* data_matrix_column(const InputOuputHelper::StreamedMatrix<F>* B,
+		const int, const unsigned int m, const unsigned int j, F* buffer) {
+	B->readColumn(j, 0, m, buffer);
+	return buffer;
+}
+
+/*
+ * B'*sgn(Z) without multiplications: an element of B is added with its sign
+ * bit flipped if the corresponding bit of sgn(Z) is set. One byte of a packed
+ * column selects 8 xor masks from a table of 256 x 8; the xor and the add
+ * run in SIMD lanes over 8 consecutive rows of B. Rows are processed in
+ * blocks of SIGN_MATRIX_ROW_BLOCK (a block of a column of B stays in cache
+ * for all columns of sgn(Z)), columns of sgn(Z) in groups of
+ * SIGN_MATRIX_COLUMN_BLOCK which share the loads of B.
+ */
+#define SIGN_MATRIX_ROW_BLOCK 4096
+#define SIGN_MATRIX_COLUMN_BLOCK 4
+
+template<typename F>
+class SignFlipMasks {
+};
+
+template<>
+class SignFlipMasks<float> {
+public:
+	typedef uint32_t Bits;
+	Bits table[256][8];
+	SignFlipMasks() {
+		for (unsigned int byte = 0; byte < 256; byte++)
+			for (unsigned int k = 0; k < 8; k++)
+				table[byte][k] = ((byte >> k) & 1) ? 0x80000000u : 0;
+	}
+};
+
+template<>
+class SignFlipMasks<double> {
+public:
+	typedef uint64_t Bits;
+	Bits table[256][8];
+	SignFlipMasks() {
+		for (unsigned int byte = 0; byte < 256; byte++)
+			for (unsigned int k = 0; k < 8; k++)
+				table[byte][k] = ((byte >> k) & 1) ? 0x8000000000000000ull : 0;
+	}
+};
+
+template<typename F>
+const SignFlipMasks<F>& sign_flip_masks() {
+	static const SignFlipMasks<F> masks;
+	return masks;
+}
+
+/*
+ * V = B'*sgn(Z) (V += B'*sgn(Z) if "accumulate"), B is m x n with leading
+ * dimension ldB, V is n x S.columns with leading dimension ldV
+ */
+template<typename F>
+void sign_matrix_multiply(const unsigned int m, const unsigned int n,
+		const F* B, const int ldB, const SolverStructures::SignMatrix& S,
+		F* V, const int ldV, const bool accumulate) {
+	typedef typename SignFlipMasks<F>::Bits Bits;
+	const SignFlipMasks<F>& masks = sign_flip_masks<F>();
+	const unsigned int columns = S.columns;
+	for (unsigned int row = 0; row < m; row += SIGN_MATRIX_ROW_BLOCK) {
+		const unsigned int rows = std::min((unsigned int) SIGN_MATRIX_ROW_BLOCK,
+				m - row);
+		const bool add = accumulate || row > 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+		for (unsigned int i = 0; i < n; i++) {
+			const F* b = &B[(size_t) ldB * i + row];
+			for (unsigned int first = 0; first < columns; first +=
+					SIGN_MATRIX_COLUMN_BLOCK) {
+				const unsigned int block = std::min(
+						(unsigned int) SIGN_MATRIX_COLUMN_BLOCK,
+						columns - first);
+				const uint8_t* signs[SIGN_MATRIX_COLUMN_BLOCK];
+				F sums[SIGN_MATRIX_COLUMN_BLOCK][8];
+				for (unsigned int q = 0; q < block; q++) {
+					signs[q] = S.column(first + q) + row / 8;
+					for (unsigned int k = 0; k < 8; k++)
+						sums[q][k] = 0;
+				}
+				for (unsigned int c = 0; c < rows / 8; c++) {
+					Bits values[8];
+					memcpy(values, &b[8 * c], sizeof(values));
+					for (unsigned int q = 0; q < block; q++) {
+						const Bits* mask = masks.table[signs[q][c]];
+						for (unsigned int k = 0; k < 8; k++) {
+							const Bits flipped = values[k] ^ mask[k];
+							F value;
+							memcpy(&value, &flipped, sizeof(F));
+							sums[q][k] += value;
+						}
+					}
+				}
+				for (unsigned int q = 0; q < block; q++) {
+					F sum = 0;
+					for (unsigned int k = 0; k < 8; k++)
+						sum += sums[q][k];
+					for (unsigned int r = rows - rows % 8; r < rows; r++)
+						sum += ((signs[q][r / 8] >> (r % 8)) & 1) ? -b[r] : b[r];
+					F* v = &V[(size_t) ldV * (first + q) + i];
+					*v = add ? *v + sum : sum;
+				}
+			}
+		}
+	}
+	// exact zeros of z were added as +1
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (unsigned int j = 0; j < columns; j++) {
+		const std::vector<unsigned int>& zeros = S.zeros[j];
+		for (unsigned int z = 0; z < zeros.size(); z++)
+			cblas_vector_add(n, (F) -1, &B[zeros[z]], ldB, &V[(size_t) ldV * j],
+					1);
+	}
+}
+
+/*
+ * Fused iteration: both products of an iteration in one pass over B. For
+ * every row panel B_r, Z_r = B_r*V is transformed right away (sgn(Z_r) if
+ * "sign") and W += B_r'*Z_r, so B_r is read from memory (disk) once and then
+ * from cache. This is exact, because sgn is elementwise and the
+ * normalization of z in L2 formulations only scales W: norms[j] receives
+ * \|z_j\|_1 ("sign") or \|z_j\|_2 and the caller scales W if needed.
+ * V and W are n x experiments, Z is m x experiments.
+ *
+ * For in-memory B the panel has to stay in cache (FUSED_PANEL_BYTES) and be
+ * tall enough that the extra reads of W (n x experiments per panel) cost less
+ * than the second pass over B (FUSED_MIN_ROWS_PER_EXPERIMENT rows per
+ * column of V); otherwise, or if B fits in cache as a whole, false is
+ * returned and the caller does two GEMMs.
+ */
+#define FUSED_PANEL_BYTES (4 << 20)
+#define FUSED_MIN_ROWS_PER_EXPERIMENT 4
+
+template<typename F>
+void power_step_panel(const F* panel, const int ldPanel,
+		const unsigned int row, const unsigned int rows, const unsigned int m,
+		const unsigned int n, const unsigned int experiments, const F* V,
+		F* Z, F* W, F* norms, const bool sign) {
+	cblas_matrix_matrix_multiply(CblasColMajor, CblasNoTrans, CblasNoTrans,
+			rows, experiments, n, 1, panel, ldPanel, V, n, 0, &Z[row], m);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (unsigned int j = 0; j < experiments; j++) {
+		F* z = &Z[(size_t) m * j + row];
+		if (sign) {
+			norms[j] += vector_l1_norm_and_sgn(z, rows);
+		} else {
+			norms[j] += cblas_vector_dot(rows, z, 1, z, 1);
+		}
+	}
+	cblas_matrix_matrix_multiply(CblasColMajor, CblasTrans, CblasNoTrans, n,
+			experiments, rows, 1, panel, ldPanel, &Z[row], m,
+			(row == 0) ? 0 : 1, W, n);
+}
+
+template<typename F>
+void finish_power_step(const unsigned int experiments, F* norms,
+		const bool sign) {
+	if (!sign) {
+		for (unsigned int j = 0; j < experiments; j++)
+			norms[j] = sqrt(norms[j]);
+	}
+}
+
+template<typename F>
+bool data_matrix_power_step(const unsigned int m, const unsigned int n,
+		const unsigned int experiments, const F* B, const int ldB, const F* V,
+		F* Z, F* W, F* norms, const bool sign) {
+	const size_t panelRows = FUSED_PANEL_BYTES / ((size_t) n * sizeof(F));
+	if (panelRows >= m
+			|| panelRows < (size_t) FUSED_MIN_ROWS_PER_EXPERIMENT * experiments)
+		return false;
+	for (unsigned int j = 0; j < experiments; j++)
+		norms[j] = 0;
+	for (unsigned int row = 0; row < m; row += panelRows) {
+		const unsigned int rows = std::min((unsigned int) panelRows, m - row);
+		power_step_panel(&B[row], ldB, row, rows, m, n, experiments, V, Z, W,
+				norms, sign);
+	}
+	finish_power_step(experiments, norms, sign);
+	return true;
+}
+
+// tiles of 16-bit B are decoded for every product, so there is no gain
+template<typename F>
+bool data_matrix_power_step(const unsigned int, const unsigned int,
+		const unsigned int, const SolverStructures::ReducedPrecisionMatrix<F>*,
+		const int, const F*, F*, F*, F*, const bool) {
+	return false;
+}
+
+// out-of-core B is always read in panels (see streamed_matrix.h)
+template<typename F>
+bool data_matrix_power_step(const unsigned int m, const unsigned int n,
+		const unsigned int experiments,
+		const InputOuputHelper::StreamedMatrix<F>* B, const int,
+		const F* V, F* Z, F* W, F* norms, const bool sign) {
+	for (unsigned int j = 0; j < experiments; j++)
+		norms[j] = 0;
+	for (unsigned int p = 0; p < B->panels; p++) {
+		const unsigned int rows = B->rowsOfPanel(p);
+		power_step_panel(B->panel(p), rows, p * B->panelRows, rows, m, n,
+				experiments, V, Z, W, norms, sign);
+	}
+	finish_power_step(experiments, norms, sign);
+	return true;
+}
+
+/*
+ * Iteration of L1 formulations which keeps Z only as packed signs (see
+ * sign_matrix.h): for every row panel B_r, Z_r = B_r*V is formed in Z
+ * (rows x experiments), packed into "signs" together with \|z_j\|_1, which
+ * is added to norms[j], and W += B_r'*sgn(Z_r) is computed right away from
+ * the packed signs. Only one panel of Z is ever held in F, its rows are given
+ * by packed_sign_panel_rows. V and W are n x experiments.
+ */
+template<typename F>
+void packed_sign_panel(const F* panel, const int ldPanel,
+		const unsigned int row, const unsigned int rows, const unsigned int n,
+		const unsigned int experiments, const F* V, F* Z, F* W, F* norms,
+		SolverStructures::SignMatrix* signs) {
+	cblas_matrix_matrix_multiply(CblasColMajor, CblasNoTrans, CblasNoTrans,
+			rows, experiments, n, 1, panel, ldPanel, V, n, 0, Z, rows);
+	signs->pack(Z, rows, rows, experiments, norms);
+	sign_matrix_multiply(rows, n, panel, ldPanel, *signs, W, n, row > 0);
+}
+
+// rows of a panel of Z (a panel of B stays in cache), 0 if B is not supported
+template<typename F>
+unsigned int packed_sign_panel_rows(const unsigned int m, const unsigned int n,
+		const F*) {
+	const size_t rows = FUSED_PANEL_BYTES / ((size_t) n * sizeof(F));
+	return (unsigned int) std::min((size_t) m, std::max((size_t) 8, rows));
+}
+
+// 16-bit B would have to be decoded for every panel twice
+template<typename F>
+unsigned int packed_sign_panel_rows(const unsigned int, const unsigned int,
+		const SolverStructures::ReducedPrecisionMatrix<F>*) {
+	return 0;
+}
+
+template<typename F>
+unsigned int packed_sign_panel_rows(const unsigned int, const unsigned int,
+		const InputOuputHelper::StreamedMatrix<F>* B) {
+	return B->panelRows;
+}
+
+template<typename F>
+void data_matrix_packed_sign_step(const unsigned int m, const unsigned int n,
+		const unsigned int experiments, const F* B, const int ldB, const F* V,
+		F* Z, F* W, F* norms, SolverStructures::SignMatrix* signs) {
+	const unsigned int panelRows = packed_sign_panel_rows(m, n, B);
+	for (unsigned int j = 0; j < experiments; j++)
+		norms[j] = 0;
+	for (unsigned int row = 0; row < m; row += panelRows) {
+		const unsigned int rows = std::min(panelRows, m - row);
+		packed_sign_panel(&B[row], ldB, row, rows, n, experiments, V, Z, W,
+				norms, signs);
+	}
+}
+
+template<typename F>
+void data_matrix_packed_sign_step(const unsigned int, const unsigned int,
+		const unsigned int, const SolverStructures::ReducedPrecisionMatrix<F>*,
+		const int, const F*, F*, F*, F*, SolverStructures::SignMatrix*) {
+}
+
+template<typename F>
+void data_matrix_packed_sign_step(const unsigned int, const unsigned int n,
+		const unsigned int experiments,
+		const InputOuputHelper::StreamedMatrix<F>* B, const int, const F* V,
+		F* Z, F* W, F* norms, SolverStructures::SignMatrix* signs) {
+	for (unsigned int j = 0; j < experiments; j++)
+		norms[j] = 0;
+	for (unsigned int p = 0; p < B->panels; p++) {
+		const unsigned int rows = B->rowsOfPanel(p);
+		packed_sign_panel(B->panel(p), rows, p * B->panelRows, rows, n,
+				experiments, V, Z, W, norms, signs);
+	}
+}
+
+#endif /* DATA_MATRIX_H_ */
@@ -0,0 +1,166 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  Projection deflation by already computed (sparse) components. The solvers
+ *  work with B (I - QQ') where columns of Q are orthonormalized components.
+ *
+ */
+
+#ifndef DEFLATION_H_
+#define DEFLATION_H_
+
+#include <math.h>
+#include <vector>
+#include "../utils/my_cblas_wrapper.h"
+
+namespace SPCASolver {
+
+/*
+ * Q is stored only on the union of supports of all components ("support"),
+ * as a dense |support| x components column-major block. One call of deflateV
+ * or deflateZ applies all components at once and is parallel over columns.
+ */
+template<typename F>
+class SparseDeflationCollection {
+public:
+	std::vector<int> support; // union of supports of all components
+	std::vector<F> Q; // support.size() x components, orthonormal columns
+	std::vector<F> BQ; // m x components, image B*Q computed by the solver
+	unsigned int components;
+
+	SparseDeflationCollection() {
+		components = 0;
+	}
+
+	bool empty() const {
+		return components == 0;
+	}
+
+	/*
+	 * Adds new component x (length n). It is orthogonalized against previous
+	 * ones (two passes of Gram-Schmidt), so the deflation is an orthogonal
+	 * projection also for non-orthogonal sparse components. A component which
+	 * lies in the span of previous ones is ignored.
+	 */
+	void addNewSparsePV(const F* x, const int n) {
+		if (position.size() < (size_t) n)
+			position.resize(n, -1);
+		const unsigned int oldSupport = support.size();
+		for (int i = 0; i < n; i++) {
+			if (x[i] != 0 && position[i] < 0) {
+				position[i] = support.size();
+				support.push_back(i);
+			}
+		}
+		const unsigned int length = support.size();
+		if (length != oldSupport && components > 0) {
+			// change leading dimension of Q, new rows are zero
+			std::vector<F> resized((size_t) length * components, 0);
+			for (unsigned int p = 0; p < components; p++)
+				for (unsigned int s = 0; s < oldSupport; s++)
+					resized[s + (size_t) p * length] = Q[s
+							+ (size_t) p * oldSupport];
+			Q.swap(resized);
+		}
+		std::vector<F> q(length);
+		for (unsigned int s = 0; s < length; s++)
+			q[s] = x[support[s]];
+		const F originalNorm = cblas_l2_norm(length, &q[0], 1);
+		for (int pass = 0; pass < 2; pass++) {
+			for (unsigned int p = 0; p < components; p++) {
+				const F* column = &Q[(size_t) p * length];
+				F dot = 0;
+				for (unsigned int s = 0; s < length; s++)
+					dot += column[s] * q[s];
+				for (unsigned int s = 0; s < length; s++)
+					q[s] -= dot * column[s];
+			}
+		}
+		const F norm = cblas_l2_norm(length, &q[0], 1);
+		if (!(norm > 1e-10 * originalNorm))
+			return;
+		for (unsigned int s = 0; s < length; s++)
+			q[s] /= norm;
+		Q.insert(Q.end(), q.begin(), q.end());
+		components++;
+	}
+
+	void addNewSparsePV(std::vector<F> &x) {
+		addNewSparsePV(&x[0], x.size());
+	}
+
+	// stores Q as dense n x components matrix (for computing BQ)
+	void getDenseComponents(F* Qdense, const int n) const {
+		const unsigned int length = support.size();
+		for (size_t i = 0; i < (size_t) n * components; i++)
+			Qdense[i] = 0;
+		for (unsigned int p = 0; p < components; p++)
+			for (unsigned int s = 0; s < length; s++)
+				Qdense[support[s] + (size_t) p * n] = Q[s + (size_t) p * length];
+	}
+
+	// V = (I - QQ') V
+	void deflateV(F* V, const int n, const int experiments) {
+		if (empty())
+			return;
+		computeCoefficients(V, n, experiments);
+		const unsigned int length = support.size();
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for (int ex = 0; ex < experiments; ex++) {
+			F* v = &V[(size_t) n * ex];
+			const F* c = &coefficients[(size_t) components * ex];
+			for (unsigned int p = 0; p < components; p++) {
+				const F* column = &Q[(size_t) p * length];
+				for (unsigned int s = 0; s < length; s++)
+					v[support[s]] -= c[p] * column[s];
+			}
+		}
+	}
+
+	// Z = Z - BQ (Q'V), i.e. Z = B (I - QQ') V if Z = B V on input. V is not changed.
+	void deflateZ(F* Z, const F* V, const int m, const int n,
+			const int experiments) {
+		if (empty())
+			return;
+		computeCoefficients(V, n, experiments);
+		cblas_matrix_matrix_multiply(CblasColMajor, CblasNoTrans, CblasNoTrans,
+				m, experiments, components, -1, &BQ[0], m, &coefficients[0],
+				components, 1, Z, m);
+	}
+
+private:
+	std::vector<int> position; // position of coordinate in "support", -1 if not there
+	std::vector<F> coefficients; // components x experiments, Q'V
+
+	void computeCoefficients(const F* V, const int n, const int experiments) {
+		const unsigned int length = support.size();
+		coefficients.resize((size_t) components * experiments);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for (int ex = 0; ex < experiments; ex++) {
+			const F* v = &V[(size_t) n * ex];
+			for (unsigned int p = 0; p < components; p++) {
+				const F* column = &Q[(size_t) p * length];
+				F dot = 0;
+				for (unsigned int s = 0; s < length; s++)
+					dot += column[s] * v[support[s]];
+				coefficients[(size_t) components * ex + p] = dot;
+			}
+		}
+	}
+};
+
+}
+#endif /* DEFLATION_H_ */
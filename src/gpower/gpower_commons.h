@@ -16,32 +16,56 @@
 #define GPOWER_COMMONS_H_
 
 #include "../utils/various.h"
+#include "../utils/counter_rng.h"
+#include "../class/solver_workspace.h"
+#include "deflation.h"
+#include "data_matrix.h"
+#include "starting_points.h"
 
-// this function generate initial points
+#define ACTIVE_SET_PANEL 256
+// if union of active columns is larger than this fraction of n, dense GEMM is used
+#define ACTIVE_SET_MAX_DENSITY 0.5
+// automatic Gram matrix mode is not used for larger n (memory n^2)
+#define GRAM_MATRIX_MAX_DIMENSION 16384
+
+/*
+ * this function generate initial points; starting point number j + batchshift
+ * is always the same (stream of the counter based generator), no matter which
+ * thread, batch or slot generates it. Data driven strategies are generated by
+ * heuristics (see starting_points.h). Points of constrained problems have
+ * "cardinality" nonzeros (0 means constraintParameter).
+ */
 template<typename F>
-void getSignleStartingPoint(F* V, F* Z,
+void getSignleStartingPoint(F* V,
 		SolverStructures::OptimizationSettings* optimizationSettings,
-		const unsigned int n, const unsigned int m, int batchshift,
-		unsigned int j) {
-	if (optimizationSettings->isConstrainedProblem()) {
-		myseed = j + batchshift;
+		const unsigned int n, int batchshift, unsigned int j,
+		const SPCASolver::StartingPointHeuristics<F>* heuristics = NULL,
+		unsigned int cardinality = 0) {
+	const unsigned int point = j + batchshift;
+	if (cardinality == 0)
+		cardinality = optimizationSettings->constraintParameter;
+	if (heuristics != NULL
+			&& optimizationSettings->startingPointStrategy
+					!= SolverStructures::RandomStartingPoints) {
+		cblas_vector_scale(n, V, (F) 0);
+		heuristics->generate(V, optimizationSettings, point, cardinality);
+	} else if (optimizationSettings->isConstrainedProblem()) {
 		F tmp_norm = 0;
-		for (unsigned int i = 0; i < optimizationSettings->constraintParameter; i++) {
-			unsigned int idx = (int) (n * (F) rand_r(&myseed) / (RAND_MAX));
-			if (idx == n)
-				idx--;
-			F tmp = (F) rand_r(&myseed) / RAND_MAX;
+		for (unsigned int i = 0; i < cardinality; i++) {
+			unsigned int idx = (unsigned int) (n
+					* counter_rng_uniform<double>(optimizationSettings->seed,
+							point, 2 * i));
+			if (idx >= n)
+				idx = n - 1;
+			F tmp = counter_rng_uniform<F>(optimizationSettings->seed, point,
+					2 * i + 1);
 			V[idx] = tmp;
 			tmp_norm += tmp * tmp;
 		}
 		cblas_vector_scale(n, V, 1 / sqrt(tmp_norm));
 	} else {
-		myseed = j + batchshift;
-		for (unsigned int i = 0; i < n; i++) {
-			F tmp = (F) rand_r(&myseed) / RAND_MAX;
-			tmp = -1 + 2 * tmp;
-			V[i] = tmp;
-		}
+		counter_rng_fill_uniform(V, n, (F) -1, (F) 1, optimizationSettings->seed,
+				point);
 	}
 
 }
@@ -53,67 +77,166 @@ void initialize_totalStartingPoints(F* V, F* Z,
 		SolverStructures::OptimizationStatistics* optimizationStatistics,
 		const unsigned int number_of_experiments_per_batch,
 		const unsigned int n, const unsigned int m, const int ldB, const F* B,
-		int batchshift = 0) {
+		int batchshift = 0,
+		const SPCASolver::StartingPointHeuristics<F>* heuristics = NULL) {
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
 	for (unsigned int j = 0; j < number_of_experiments_per_batch; j++) {
-		getSignleStartingPoint(&V[j * n], &Z[j * m], optimizationSettings, n, m, batchshift,
-				j);
+		getSignleStartingPoint(&V[j * n], optimizationSettings, n, batchshift, j,
+				heuristics);
 	}
 }
 
-// do one iteration for constrained PCA
+/*
+ * Final bookkeeping of one starting point: logs its value, iterations
+ * ("it" = -1 if it did not converge) and cardinality, and keeps "v" in "x"
+ * if it is the best point so far.
+ */
 template<typename F>
-void perform_one_iteration_for_constrained_pca(F* V, F* Z,
-		SolverStructures::OptimizationSettings* optimizationSettings,
+void retire_starting_point(const F* v, const F value, F* x,
+		F& the_best_solution_value, const unsigned int n, const int it,
+		const bool storeIterationsForAllPoints,
 		SolverStructures::OptimizationStatistics* optimizationStatistics,
+		const unsigned int point) {
+	if (storeIterationsForAllPoints) {
+		optimizationStatistics->values[point] = value;
+		if (it >= 0) {
+			optimizationStatistics->iters[point] = it;
+			optimizationStatistics->cardinalities[point] = vector_get_nnz(v, n);
+		}
+	}
+	if (the_best_solution_value < value) {
+		the_best_solution_value = value;
+		cblas_vector_copy(n, v, 1, x, 1);
+	}
+}
+
+// store all columns of V in compact form
+template<typename F>
+void compress_V(SolverStructures::ActiveSetV<F>* activeSet, const F* V,
 		const unsigned int number_of_experiments_per_batch,
-		const unsigned int n, const unsigned int m, const int ldB, const F* B,
-		F* max_errors, ValueCoordinateHolder<F>* vals, std::vector<F>* buffer,
-		unsigned int it, unsigned int optimizationStatisticsistical_shift) {
-	cblas_matrix_matrix_multiply(CblasColMajor, CblasNoTrans, CblasNoTrans, m,
-			number_of_experiments_per_batch, n, 1, B, ldB, V, n, 0, Z, m); // Multiply z = B*V
-	//set Z=sgn(Z)
-	if (optimizationSettings->formulation == SolverStructures::L0_constrained_L1_PCA
-			|| optimizationSettings->formulation
-					== SolverStructures::L1_constrained_L1_PCA) {
+		const unsigned int n) {
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-		for (unsigned int j = 0; j < number_of_experiments_per_batch; j++) {
-			vals[j].tmp = cblas_l1_norm(m, &Z[m * j], 1);
-			vector_sgn(&Z[m * j], m);	//y=sgn(y)
-		}
+	for (unsigned int j = 0; j < number_of_experiments_per_batch; j++) {
+		activeSet->compressColumn(&V[j * n], n, j);
 	}
-	cblas_matrix_matrix_multiply(CblasColMajor, CblasTrans, CblasNoTrans, n,
-			number_of_experiments_per_batch, m, 1, B, ldB, Z, m, 0, V, n);// Multiply V = B'*z
+}
 
+/*
+ * Z = B*V using compact form of V. Columns of B which are nonzero in at least
+ * one column of V are gathered (in panels) into a dense buffer and multiplied
+ * by corresponding rows of V. Cost is O(m * |active| * experiments) instead of
+ * O(m * n * experiments).
+ *
+ * @return false (and Z is not touched) if the active set is too large
+ */
+template<typename F, typename Matrix>
+bool active_set_matrix_multiply(SolverStructures::ActiveSetV<F>* activeSet,
+		const unsigned int number_of_experiments_per_batch,
+		const unsigned int n, const unsigned int m, const int ldB,
+		const Matrix* B, F* Z) {
+	std::vector<unsigned int>& activeColumns = activeSet->activeColumns;
+	std::vector<int>& position = activeSet->position;
+	activeColumns.clear();
+	for (unsigned int j = 0; j < number_of_experiments_per_batch; j++) {
+		const std::vector<unsigned int>& indices = activeSet->indices[j];
+		for (unsigned int i = 0; i < indices.size(); i++) {
+			if (position[indices[i]] < 0) {
+				position[indices[i]] = 0;
+				activeColumns.push_back(indices[i]);
+			}
+		}
+	}
+	const unsigned int active = activeColumns.size();
+	if (active > ACTIVE_SET_MAX_DENSITY * n) {
+		for (unsigned int i = 0; i < active; i++)
+			position[activeColumns[i]] = -1;
+		return false;
+	}
+	// gathered columns keep the order of B
+	std::sort(activeColumns.begin(), activeColumns.end());
+	for (unsigned int i = 0; i < active; i++)
+		position[activeColumns[i]] = i;
+	F* Vactive = activeSet->Vactive.reserve(
+			(size_t) active * number_of_experiments_per_batch + 1);
+	F* Bactive = activeSet->Bactive.reserve((size_t) m * ACTIVE_SET_PANEL);
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
 	for (unsigned int j = 0; j < number_of_experiments_per_batch; j++) {
-		F fval_current = 0;
-		if (optimizationSettings->formulation == SolverStructures::L0_constrained_L2_PCA
-				|| optimizationSettings->formulation
-						== SolverStructures::L1_constrained_L2_PCA) {
-			fval_current = cblas_l2_norm(m, &Z[m * j], 1);
-		}
-		F norm_of_x;
-		if (optimizationSettings->isL1ConstrainedProblem()) {
-			norm_of_x = soft_thresholding(&V[n * j], n, optimizationSettings->constraintParameter,
-					buffer[j], optimizationSettings); // x = S_w(x)
-		} else {
-			norm_of_x = k_hard_thresholding(&V[n * j], n, optimizationSettings->constraintParameter,
-					buffer[j], optimizationSettings); // x = T_k(x)
+		F* column = &Vactive[(size_t) active * j];
+		for (unsigned int i = 0; i < active; i++)
+			column[i] = 0;
+		const std::vector<unsigned int>& indices = activeSet->indices[j];
+		const std::vector<F>& values = activeSet->values[j];
+		for (unsigned int i = 0; i < indices.size(); i++)
+			column[position[indices[i]]] = values[i];
+	}
+	if (active == 0) {
+		cblas_vector_scale(m * number_of_experiments_per_batch, Z, (F) 0);
+	}
+	for (unsigned int panel = 0; panel < active; panel += ACTIVE_SET_PANEL) {
+		const unsigned int columns =
+				(active - panel < ACTIVE_SET_PANEL) ?
+						active - panel : ACTIVE_SET_PANEL;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for (unsigned int col = 0; col < columns; col++) {
+			F* gathered = &Bactive[(size_t) col * m];
+			const F* column = data_matrix_column(B, ldB, m,
+					activeColumns[panel + col], gathered);
+			if (column != gathered)
+				cblas_vector_copy(m, column, 1, gathered, 1);
 		}
+		cblas_matrix_matrix_multiply(CblasColMajor, CblasNoTrans, CblasNoTrans,
+				m, number_of_experiments_per_batch, columns, 1, Bactive, m,
+				&Vactive[panel], active, (panel == 0) ? 0 : 1, Z, m);
+	}
+	for (unsigned int i = 0; i < active; i++)
+		position[activeColumns[i]] = -1;
+	return true;
+}
 
-		cblas_vector_scale(n, &V[j * n], 1 / norm_of_x);
-		if (optimizationSettings->formulation == SolverStructures::L0_constrained_L1_PCA
-				|| optimizationSettings->formulation
-						== SolverStructures::L1_constrained_L1_PCA) {
-			fval_current = vals[j].tmp;
+/*
+ * Thresholding part of an iteration of constrained PCA: V holds B'z (column j
+ * uses constraint parameter columnParameters[j] if given) and vals[j].tmp the
+ * objective value of the point. Columns are processed in parallel or one
+ * after another with parallel passes (see execution_policy.h).
+ */
+template<SolverStructures::SPCA_Formulation formulation, typename F>
+void constrained_thresholding(F* V,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		SolverStructures::OptimizationStatistics* optimizationStatistics,
+		const unsigned int number_of_experiments_per_batch,
+		const unsigned int n, F* max_errors, ValueCoordinateHolder<F>* vals,
+		std::vector<F>* buffer, unsigned int it,
+		unsigned int optimizationStatisticsistical_shift,
+		SolverStructures::ActiveSetV<F>* activeSet,
+		const double* columnParameters) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(optimizationSettings->executionPolicy.threadsAcrossColumns())
+#endif
+	for (unsigned int j = 0; j < number_of_experiments_per_batch; j++) {
+		const F fval_current = vals[j].tmp;
+		const unsigned int constraintParameter =
+				(columnParameters == NULL) ?
+						optimizationSettings->constraintParameter :
+						(unsigned int) columnParameters[j];
+		// x = S_w(x) / \|S_w(x)\| or x = T_k(x) / \|T_k(x)\|
+		unsigned int nnz;
+		if (SolverStructures::FormulationTraits<formulation>::L1Sparsity) {
+			soft_thresholding(&V[n * j], n, constraintParameter, buffer[j],
+					optimizationSettings, true, &nnz);
+		} else {
+			k_hard_thresholding(&V[n * j], n, constraintParameter, buffer[j],
+					optimizationSettings, true, &nnz);
 		}
+		if (activeSet != NULL)
+			activeSet->compressColumn(&V[j * n], n, j);
 		F tmp_error = computeTheError(fval_current, vals[j].val, optimizationSettings);
 		vals[j].current_error = tmp_error;
 		//Log end of iteration for given point
@@ -121,8 +244,7 @@ void perform_one_iteration_for_constrained_pca(F* V, F* Z,
 				&& termination_criteria(tmp_error, it, optimizationSettings)
 				&& optimizationStatistics->iters[optimizationStatisticsistical_shift + j] == -1) {
 			optimizationStatistics->iters[optimizationStatisticsistical_shift + j] = it;
-			optimizationStatistics->cardinalities[optimizationStatisticsistical_shift + j] = vector_get_nnz(
-					&V[j * n], n);
+			optimizationStatistics->cardinalities[optimizationStatisticsistical_shift + j] = nnz;
 		} else if (optimizationSettings->storeIterationsForAllPoints
 				&& !termination_criteria(tmp_error, it, optimizationSettings)
 				&& optimizationStatistics->iters[optimizationStatisticsistical_shift + j] != -1) {
@@ -135,45 +257,338 @@ void perform_one_iteration_for_constrained_pca(F* V, F* Z,
 	}
 }
 
-// do one iteration for penalize PCA
-template<typename F>
+/*
+ * V = B'*sgn(Z) for L1 formulations, Z is replaced by sgn(Z). If l1norms is
+ * given, l1norms[j] = \|z_j\|_1 (computed in the same pass as sgn(z_j)).
+ */
+template<typename F, typename Matrix>
+void sign_matrix_product(F* V, F* Z,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		const unsigned int number_of_experiments_per_batch,
+		const unsigned int n, const unsigned int m, const int ldB,
+		const Matrix* B, F* l1norms = NULL) {
+	const SolverStructures::ExecutionPolicy& policy =
+			optimizationSettings->executionPolicy;
+	const unsigned int threads = policy.threadsWithinVector(m);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(policy.threadsAcrossColumns())
+#endif
+	for (unsigned int j = 0; j < number_of_experiments_per_batch; j++) {
+		const F norm = vector_l1_norm_and_sgn(&Z[m * j], m, threads); //y=sgn(y)
+		if (l1norms != NULL)
+			l1norms[j] = norm;
+	}
+	data_matrix_multiply(CblasTrans, m, n, number_of_experiments_per_batch, B,
+			ldB, Z, m, V, n); // Multiply V = B'*sgn(z)
+}
+
+/*
+ * Both products of an iteration in one pass over B (see
+ * data_matrix_power_step): on success V holds B'z (B'sgn(z) for L1
+ * formulations, z = B*V) and norms[j] = \|z_j\|. "product" is n x experiments
+ * scratch memory (allocated if NULL). Not used with deflation, whose
+ * correction needs whole z.
+ */
+template<SolverStructures::SPCA_Formulation formulation, typename F,
+		typename Matrix>
+bool fused_power_step(F* V, F* Z,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		const unsigned int number_of_experiments_per_batch,
+		const unsigned int n, const unsigned int m, const int ldB,
+		const Matrix* B, F* norms,
+		SPCASolver::SparseDeflationCollection<F>* deflation, F* product) {
+	if (!optimizationSettings->useFusedProducts || deflation != NULL)
+		return false;
+	std::vector<F> localProduct;
+	if (product == NULL) {
+		localProduct.resize((size_t) n * number_of_experiments_per_batch);
+		product = &localProduct[0];
+	}
+	const bool sign = !SolverStructures::FormulationTraits<formulation>::L2Problem;
+	if (!data_matrix_power_step(m, n, number_of_experiments_per_batch, B, ldB,
+			V, Z, product, norms, sign))
+		return false;
+	cblas_vector_copy(n * number_of_experiments_per_batch, product, 1, V, 1);
+	return true;
+}
+
+/*
+ * Use of packed signs (useSignBitKernel): L1 formulations on B which supports
+ * them (see packed_sign_panel_rows), without deflation and the active set,
+ * which need whole Z. Returns rows of Z to be allocated (one panel), or 0 if
+ * Z is formed as a whole.
+ */
+template<SolverStructures::SPCA_Formulation formulation, typename Matrix>
+unsigned int packed_sign_rows(
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		const unsigned int m, const unsigned int n, const Matrix* B,
+		const bool deflation, const bool activeSet) {
+	if (!optimizationSettings->useSignBitKernel || deflation || activeSet
+			|| SolverStructures::FormulationTraits<formulation>::L2Problem)
+		return 0;
+	return packed_sign_panel_rows(m, n, B);
+}
+
+/*
+ * Both products of an iteration of L1 formulation with Z kept as packed
+ * signs (see data_matrix_packed_sign_step): Z holds one panel of
+ * packed_sign_rows rows, V receives B'sgn(z) and norms[j] = \|z_j\|_1.
+ * "product" is n x experiments scratch memory.
+ */
+template<typename F, typename Matrix>
+void packed_sign_power_step(F* V, F* Z,
+		const unsigned int number_of_experiments_per_batch,
+		const unsigned int n, const unsigned int m, const int ldB,
+		const Matrix* B, F* norms, F* product,
+		SolverStructures::SignMatrix* signs) {
+	data_matrix_packed_sign_step(m, n, number_of_experiments_per_batch, B, ldB,
+			V, Z, product, norms, signs);
+	cblas_vector_copy(n * number_of_experiments_per_batch, product, 1, V, 1);
+}
+
+/*
+ * do one iteration for constrained PCA (of B (I - QQ') if deflation is given);
+ * if columnParameters is given, column j uses constraint parameter
+ * columnParameters[j], so one pair of GEMMs serves many parameter values.
+ * If the active set does not apply, both products may be fused into one pass
+ * over B (see fused_power_step). If "signs" is given, Z is one panel and is
+ * kept as packed signs (see packed_sign_power_step).
+ */
+template<SolverStructures::SPCA_Formulation formulation, typename F,
+		typename Matrix>
+void perform_one_iteration_for_constrained_pca(F* V, F* Z,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		SolverStructures::OptimizationStatistics* optimizationStatistics,
+		const unsigned int number_of_experiments_per_batch,
+		const unsigned int n, const unsigned int m, const int ldB,
+		const Matrix* B,
+		F* max_errors, ValueCoordinateHolder<F>* vals, std::vector<F>* buffer,
+		unsigned int it, unsigned int optimizationStatisticsistical_shift,
+		SolverStructures::ActiveSetV<F>* activeSet = NULL,
+		SPCASolver::SparseDeflationCollection<F>* deflation = NULL,
+		const double* columnParameters = NULL, F* product = NULL,
+		SolverStructures::SignMatrix* signs = NULL) {
+	const bool activeSetUsed = activeSet != NULL
+			&& active_set_matrix_multiply(activeSet,
+					number_of_experiments_per_batch, n, m, ldB, B, Z);
+	std::vector<F> norms(number_of_experiments_per_batch);
+	if (signs != NULL) {
+		packed_sign_power_step(V, Z, number_of_experiments_per_batch, n, m,
+				ldB, B, &norms[0], product, signs);
+		for (unsigned int j = 0; j < number_of_experiments_per_batch; j++)
+			vals[j].tmp = norms[j];
+	} else if (!activeSetUsed
+			&& fused_power_step<formulation>(V, Z, optimizationSettings,
+					number_of_experiments_per_batch, n, m, ldB, B, &norms[0],
+					deflation, product)) {
+		for (unsigned int j = 0; j < number_of_experiments_per_batch; j++)
+			vals[j].tmp = norms[j];
+	} else {
+		if (!activeSetUsed) {
+			data_matrix_multiply(CblasNoTrans, m, n,
+					number_of_experiments_per_batch, B, ldB, V, n, Z, m); // Multiply z = B*V
+		}
+		if (deflation != NULL)
+			deflation->deflateZ(Z, V, m, n, number_of_experiments_per_batch);
+		if (!SolverStructures::FormulationTraits<formulation>::L2Problem) {
+			sign_matrix_product(V, Z, optimizationSettings,
+					number_of_experiments_per_batch, n, m, ldB, B, &norms[0]);
+			for (unsigned int j = 0; j < number_of_experiments_per_batch; j++)
+				vals[j].tmp = norms[j];
+		} else {
+			const SolverStructures::ExecutionPolicy& policy =
+					optimizationSettings->executionPolicy;
+			const unsigned int threads = policy.threadsWithinVector(m);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(policy.threadsAcrossColumns())
+#endif
+			for (unsigned int j = 0; j < number_of_experiments_per_batch; j++) {
+				vals[j].tmp = vector_l2_norm(&Z[m * j], m, threads);
+			}
+			data_matrix_multiply(CblasTrans, m, n,
+					number_of_experiments_per_batch, B, ldB, Z, m, V, n); // Multiply V = B'*z
+		}
+		if (deflation != NULL)
+			deflation->deflateV(V, n, number_of_experiments_per_batch);
+	}
+	constrained_thresholding<formulation>(V, optimizationSettings,
+			optimizationStatistics, number_of_experiments_per_batch, n,
+			max_errors, vals, buffer, it,
+			optimizationStatisticsistical_shift, activeSet, columnParameters);
+}
+
+/*
+ * do one iteration for penalize PCA (of B (I - QQ') if deflation is given);
+ * if columnParameters is given, column j uses penalty parameter
+ * columnParameters[j]; both products may be fused (see fused_power_step)
+ * or, if "signs" is given, Z kept as packed signs (see packed_sign_power_step)
+ */
+template<SolverStructures::SPCA_Formulation formulation, typename F,
+		typename Matrix>
 void perform_one_iteration_for_penalized_pca(F* V, F* Z,
 		SolverStructures::OptimizationSettings* optimizationSettings,
 		SolverStructures::OptimizationStatistics* optimizationStatistics,
 		const unsigned int number_of_experiments_per_batch,
-		const unsigned int n, const unsigned int m, const int ldB, const F* B,
+		const unsigned int n, const unsigned int m, const int ldB,
+		const Matrix* B,
 		F* max_errors, ValueCoordinateHolder<F>* vals, unsigned int it,
-		unsigned int optimizationStatisticsistical_shift) {
-	//scale Z
-	cblas_matrix_matrix_multiply(CblasColMajor, CblasNoTrans, CblasNoTrans, m,
-			number_of_experiments_per_batch, n, 1, B, ldB, V, n, 0, Z, m); // Multiply z = B*w
-	if (optimizationSettings->formulation == SolverStructures::L0_penalized_L1_PCA
-			|| optimizationSettings->formulation == SolverStructures::L1_penalized_L1_PCA) {
+		unsigned int optimizationStatisticsistical_shift,
+		SPCASolver::SparseDeflationCollection<F>* deflation = NULL,
+		const double* columnParameters = NULL, F* product = NULL,
+		SolverStructures::SignMatrix* signs = NULL) {
+	// L2 formulations: v = B'z / \|z\| is scaled within the thresholding
+	std::vector<F> norms(number_of_experiments_per_batch);
+	if (signs != NULL) {
+		packed_sign_power_step(V, Z, number_of_experiments_per_batch, n, m,
+				ldB, B, &norms[0], product, signs);
+	} else if (!fused_power_step<formulation>(V, Z, optimizationSettings,
+			number_of_experiments_per_batch, n, m, ldB, B, &norms[0], deflation,
+			product)) {
+		data_matrix_multiply(CblasNoTrans, m, n, number_of_experiments_per_batch, B,
+				ldB, V, n, Z, m); // Multiply z = B*w
+		if (deflation != NULL)
+			deflation->deflateZ(Z, V, m, n, number_of_experiments_per_batch);
+		if (!SolverStructures::FormulationTraits<formulation>::L2Problem) {
+			sign_matrix_product(V, Z, optimizationSettings,
+					number_of_experiments_per_batch, n, m, ldB, B);
+		} else {
+			const SolverStructures::ExecutionPolicy& policy =
+					optimizationSettings->executionPolicy;
+			const unsigned int threads = policy.threadsWithinVector(m);
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for num_threads(policy.threadsAcrossColumns())
 #endif
-		for (unsigned int j = 0; j < number_of_experiments_per_batch; j++) {
-			vector_sgn(&Z[m * j], m);
+			for (unsigned int j = 0; j < number_of_experiments_per_batch; j++) {
+				norms[j] = vector_l2_norm(&Z[m * j], m, threads);
+			}
+			data_matrix_multiply(CblasTrans, m, n,
+					number_of_experiments_per_batch, B, ldB, Z, m, V, n); // Multiply v = B'*z
 		}
+		if (deflation != NULL)
+			deflation->deflateV(V, n, number_of_experiments_per_batch);
+	}
+	const F* scales = NULL;
+	if (SolverStructures::FormulationTraits<formulation>::L2Problem) {
+		for (unsigned int j = 0; j < number_of_experiments_per_batch; j++)
+			norms[j] = 1 / norms[j];
+		scales = &norms[0];
+	}
+	if (SolverStructures::FormulationTraits<formulation>::L1Sparsity) {
+		L1_penalized_thresholding(number_of_experiments_per_batch, n, V,
+				optimizationSettings, max_errors, vals, optimizationStatistics, it,
+				0, columnParameters, scales);
 	} else {
+		L0_penalized_thresholding(number_of_experiments_per_batch, n, V,
+				optimizationSettings, max_errors, vals, optimizationStatistics, it,
+				0, columnParameters, scales);
+	}
+
+}
+
+/*
+ * Gram matrix mode (L2 formulations only). With G = B'B the iteration needs
+ * only G*V: for z = Bv we have B'z = Gv and \|z\|^2 = v'Gv, so one n x n
+ * GEMM replaces the two m x n ones.
+ *
+ * Cost model (multiply-adds): forming G costs m n (n + 1) / 2 (SYRK), an
+ * iteration of one point n^2 instead of 2 m n. The budget of iterations is
+ * totalStartingPoints * maximumIterations (times number of parameter values).
+ */
+template<typename F>
+bool use_gram_matrix(
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		const unsigned int m, const unsigned int n,
+		const unsigned int parameterValues = 1) {
+	if (!optimizationSettings->isL2Problem())
+		return false;
+	switch (optimizationSettings->gramMatrixMode) {
+	case SolverStructures::NoGramMatrix:
+		return false;
+	case SolverStructures::UseGramMatrix:
+		return true;
+	default:
+		break;
+	}
+	if (n > GRAM_MATRIX_MAX_DIMENSION)
+		return false;
+	const double budget = (double) optimizationSettings->totalStartingPoints
+			* optimizationSettings->maximumIterations * parameterValues;
+	const double gram_cost = (double) m * n * (n + 1) / 2
+			+ budget * n * (double) n;
+	const double data_cost = budget * 2 * (double) m * n;
+	return gram_cost < data_cost;
+}
+
+// G = B'B (n x n, both triangles), formed by one parallel SYRK
+template<typename F>
+void compute_gram_matrix(const F* B, const int ldB, const unsigned int m,
+		const unsigned int n, F* G) {
+	cblas_symmetric_rank_k_update(CblasColMajor, CblasUpper, CblasTrans, n, m,
+			(F) 1, B, ldB, (F) 0, G, n);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+	for (unsigned int j = 0; j < n; j++) {
+		for (unsigned int i = j + 1; i < n; i++)
+			G[i + (size_t) n * j] = G[j + (size_t) n * i];
+	}
+}
+
+/*
+ * do one iteration of L2 formulation on Gram matrix G (of (I - QQ') G (I - QQ')
+ * if deflation is given, deflation->BQ has to hold G*Q); W is n x experiments
+ * buffer. Iterates are the same as for B, see use_gram_matrix.
+ */
+template<SolverStructures::SPCA_Formulation formulation, typename F,
+		typename Matrix>
+void perform_one_iteration_with_gram_matrix(F* V, F* W,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		SolverStructures::OptimizationStatistics* optimizationStatistics,
+		const unsigned int number_of_experiments_per_batch,
+		const unsigned int n, const int ldG, const Matrix* G, F* max_errors,
+		ValueCoordinateHolder<F>* vals, std::vector<F>* buffer, unsigned int it,
+		unsigned int optimizationStatisticsistical_shift,
+		SolverStructures::ActiveSetV<F>* activeSet = NULL,
+		SPCASolver::SparseDeflationCollection<F>* deflation = NULL,
+		const double* columnParameters = NULL) {
+	if (activeSet == NULL
+			|| !active_set_matrix_multiply(activeSet,
+					number_of_experiments_per_batch, n, n, ldG, G, W)) {
+		data_matrix_multiply(CblasNoTrans, n, n,
+				number_of_experiments_per_batch, G, ldG, V, n, W, n); // Multiply W = G*V
+	}
+	if (deflation != NULL) {
+		deflation->deflateZ(W, V, n, n, number_of_experiments_per_batch);
+		deflation->deflateV(W, n, number_of_experiments_per_batch);
+	}
+	const bool constrained =
+			SolverStructures::FormulationTraits<formulation>::constrained;
+	// penalized: v = B'z, z = Bv / \|Bv\|, is scaled within the thresholding
+	std::vector<F> scales(number_of_experiments_per_batch);
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-		for (unsigned int j = 0; j < number_of_experiments_per_batch; j++) {
-			F tmp_norm = cblas_l2_norm(m, &Z[m * j], 1);
-			cblas_vector_scale(m, &Z[j * m], 1 / tmp_norm);
-		}
+	for (unsigned int j = 0; j < number_of_experiments_per_batch; j++) {
+		F norm_of_z = cblas_vector_dot(n, &V[n * j], 1, &W[n * j], 1);
+		norm_of_z = (norm_of_z > 0) ? sqrt(norm_of_z) : 0; // \|Bv\|
+		vals[j].tmp = norm_of_z;
+		scales[j] = 1 / norm_of_z;
+		cblas_vector_copy(n, &W[n * j], 1, &V[n * j], 1);
 	}
-	cblas_matrix_matrix_multiply(CblasColMajor, CblasTrans, CblasNoTrans, n,
-			number_of_experiments_per_batch, m, 1, B, ldB, Z, m, 0, V, n); // Multiply v = B'*z
-	if (optimizationSettings->isL1PenalizedProblem()) {
+	if (constrained) {
+		constrained_thresholding<formulation>(V, optimizationSettings,
+				optimizationStatistics, number_of_experiments_per_batch, n,
+				max_errors, vals, buffer, it, optimizationStatisticsistical_shift,
+				activeSet, columnParameters);
+	} else if (SolverStructures::FormulationTraits<formulation>::L1Sparsity) {
 		L1_penalized_thresholding(number_of_experiments_per_batch, n, V,
-				optimizationSettings, max_errors, vals, optimizationStatistics, it);
+				optimizationSettings, max_errors, vals, optimizationStatistics, it,
+				0, columnParameters, &scales[0]);
 	} else {
 		L0_penalized_thresholding(number_of_experiments_per_batch, n, V,
-				optimizationSettings, max_errors, vals, optimizationStatistics, it);
+				optimizationSettings, max_errors, vals, optimizationStatistics, it,
+				0, columnParameters, &scales[0]);
 	}
-
 }
 
 #endif /* GPOWER_COMMONS_H_ */
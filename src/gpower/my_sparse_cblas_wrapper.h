@@ -10,122 +10,207 @@
  * The code is available at https://code.google.com/p/24am/
  * under GNU GPL v3 License
  * 
- *  this file contains wrapper for sprace blas. This enables us to use float and double precission
+ *  this file contains sparse matrix - dense block kernels used by the CSC solver.
+ *  They work for float and double precission and do not need MKL.
  *
  */
 
 #ifndef MY_SPARSE_WRAPPER_H_
 #define MY_SPARSE_WRAPPER_H_
 
-#include "mkl_spblas.h"
+#include <vector>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-char* MY_SPARSE_WRAPPER_TRANS = "T";
-char* MY_SPARSE_WRAPPER_NOTRANS = "N";
+// number of starting points processed in one pass over a column (row) of B
+#define SPARSE_EXPERIMENTS_BLOCK 8
 
-// matrix matrix multiply
-template<typename F>
-void my_mm_multiply(bool trans, const int m, const int n, const int experiments,
-		const F* vals, const int* row_id, const int* colPtr, const F* means,
-		F* x, F*y) {
-
-	for (int ex = 0; ex < experiments; ex++) {
-		if (trans) {
-			for (int row = 0; row < n; row++)
-				y[row + ex * n] = 0;
-		} else {
-			for (int row = 0; row < m; row++)
-				y[row + ex * m] = 0;
+/*
+ * Z = (B - 1*means' - rowMeans*1') * V
+ *
+ * B is m x n matrix in CSC format, V (n x experiments) and Z (m x experiments)
+ * are dense column-major blocks (the same layout as the solver uses).
+ * "means" and "rowMeans" can be NULL. The rank-one corrections are not applied
+ * as a separate pass, they are used as the initial value of Z.
+ * If CSR copy of B is given (csrVals != NULL), rows of Z are computed in
+ * parallel, otherwise the columns of Z (experiments) are split between threads.
+ */
+template<typename F, typename I>
+void sparse_matrix_dense_block_multiply(const int m, const int n,
+		const int experiments, const F* vals, const I* rowId, const I* colPtr,
+		const F* csrVals, const I* csrColId, const I* csrRowPtr,
+		const F* means, const F* rowMeans, const F* V, F* Z) {
+	std::vector<F> shift(experiments, 0);
+	std::vector<F> total(experiments, 0);
+	if (means != NULL || rowMeans != NULL) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for (int ex = 0; ex < experiments; ex++) {
+			const F* v = &V[(long long) ex * n];
+			F tmpShift = 0;
+			F tmpTotal = 0;
+			for (int col = 0; col < n; col++) {
+				if (means != NULL)
+					tmpShift += means[col] * v[col];
+				tmpTotal += v[col];
+			}
+			shift[ex] = tmpShift;
+			total[ex] = tmpTotal;
 		}
 	}
-
-	for (int ex = 0; ex < experiments; ex++) {
-		if (trans) {
-			//  y=B'*x
-			for (int col = 0; col < n; col++) {
-				int startMR = row_id[colPtr[col]];
-				for (int row = 0; row < startMR; row++) {
-					y[col + ex * n] -= x[ex * m + row] * means[col];
-				}
-				int lastMR = 0;
-				for (int rowId = colPtr[col]; rowId < colPtr[col + 1];
-						rowId++) {
-					int tmp_row = row_id[rowId];
-					y[col + ex * n] += x[ex * m + tmp_row] * (vals[rowId]- means[col]);
-					//					y[tmp_row + ex * m] += xval * vals[rowId];
-					if (rowId < colPtr[col + 1] - 1) {
-						for (int row = tmp_row; row < row_id[rowId + 1];
-								row++) {
-							//							y[row + ex * m] += xval * means[col];
-							y[col + ex * n] -= x[ex * m + row] * means[col];
-						}
-					}
-					lastMR = row_id[rowId];
+	if (csrVals != NULL) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,64)
+#endif
+		for (int row = 0; row < m; row++) {
+			const F rowMean = (rowMeans == NULL) ? 0 : rowMeans[row];
+			for (int exStart = 0; exStart < experiments; exStart +=
+					SPARSE_EXPERIMENTS_BLOCK) {
+				const int block = std::min(SPARSE_EXPERIMENTS_BLOCK,
+						experiments - exStart);
+				const F* v = &V[(long long) exStart * n];
+				F acc[SPARSE_EXPERIMENTS_BLOCK];
+				for (int b = 0; b < block; b++)
+					acc[b] = -shift[exStart + b] - rowMean * total[exStart + b];
+				for (I k = csrRowPtr[row]; k < csrRowPtr[row + 1]; k++) {
+					const F val = csrVals[k];
+					const F* vCol = &v[csrColId[k]];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+					for (int b = 0; b < block; b++)
+						acc[b] += val * vCol[(long long) b * n];
 				}
-				for (int row = lastMR + 1; row < m; row++) {
-					y[col + ex * n] -= x[ex * m + row] * means[col];
+				for (int b = 0; b < block; b++)
+					Z[row + (long long) (exStart + b) * m] = acc[b];
+			}
+		}
+	} else {
+		const int blocks = (experiments + SPARSE_EXPERIMENTS_BLOCK - 1)
+				/ SPARSE_EXPERIMENTS_BLOCK;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for (int blk = 0; blk < blocks; blk++) {
+			const int exStart = blk * SPARSE_EXPERIMENTS_BLOCK;
+			const int block = std::min(SPARSE_EXPERIMENTS_BLOCK,
+					experiments - exStart);
+			for (int b = 0; b < block; b++) {
+				const int ex = exStart + b;
+				F* z = &Z[(long long) ex * m];
+				if (rowMeans != NULL) {
+					for (int row = 0; row < m; row++)
+						z[row] = -shift[ex] - rowMeans[row] * total[ex];
+				} else {
+					for (int row = 0; row < m; row++)
+						z[row] = -shift[ex];
 				}
-
 			}
-
-		} else {
-			//  y=B*x
+			const F* v = &V[(long long) exStart * n];
+			F* z = &Z[(long long) exStart * m];
 			for (int col = 0; col < n; col++) {
-				F xval = x[col + ex * n];
-				if (xval != 0) {
-					int startMR = row_id[colPtr[col]];
-					for (int row = 0; row < startMR; row++) {
-						y[row + ex * m] -= xval * means[col];
-					}
-					int lastMR = 0;
-					for (int rowId = colPtr[col]; rowId < colPtr[col + 1];
-							rowId++) {
-						int tmp_row = row_id[rowId];
-						y[tmp_row + ex * m] += xval * (vals[rowId]-means[col]);
-						if (rowId < colPtr[col + 1] - 1) {
-							for (int row = tmp_row; row < row_id[rowId + 1];
-									row++) {
-								y[row + ex * m] -= xval * means[col];
-							}
-						}
-						lastMR = row_id[rowId];
-					}
-					for (int row = lastMR + 1; row < m; row++) {
-						y[row + ex * m] -= xval * means[col];
-					}
-
+				F xval[SPARSE_EXPERIMENTS_BLOCK];
+				bool nonzero = false;
+				for (int b = 0; b < block; b++) {
+					xval[b] = v[col + (long long) b * n];
+					nonzero = nonzero || (xval[b] != 0);
+				}
+				if (!nonzero)
+					continue; // sparse V (constrained formulations)
+				for (I k = colPtr[col]; k < colPtr[col + 1]; k++) {
+					const F val = vals[k];
+					F* zRow = &z[rowId[k]];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+					for (int b = 0; b < block; b++)
+						zRow[(long long) b * m] += val * xval[b];
 				}
 			}
 		}
 	}
 }
 
-void sparse_matrix_matrix_multiply(char *transa, int mI, int nI, int kI,
-		double *alpha, char *matdescra, double *val, MKL_INT *indx,
-		MKL_INT *pntrb, MKL_INT *pntre, double *b, int ldbI, double *beta,
-		double *c, int ldcI) {
-
-	MKL_INT m = mI;
-	MKL_INT n = nI;
-	MKL_INT k = kI;
-	MKL_INT ldc = ldcI;
-	MKL_INT ldb = ldbI;
-
-	mkl_dcscmm(transa, &m, &n, &k, alpha, matdescra, val, indx, pntrb, pntre, b,
-			&ldb, beta, c, &ldc);
+/*
+ * V = (B - 1*means' - rowMeans*1')' * Z
+ *
+ * Columns of B (rows of V) are independent and are split between threads.
+ */
+template<typename F, typename I>
+void sparse_matrix_transposed_dense_block_multiply(const int m, const int n,
+		const int experiments, const F* vals, const I* rowId, const I* colPtr,
+		const F* means, const F* rowMeans, const F* Z, F* V) {
+	std::vector<F> columnSum(experiments, 0);
+	std::vector<F> rowMeansDot(experiments, 0);
+	if (means != NULL || rowMeans != NULL) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for (int ex = 0; ex < experiments; ex++) {
+			const F* z = &Z[(long long) ex * m];
+			F tmpSum = 0;
+			F tmpDot = 0;
+			for (int row = 0; row < m; row++) {
+				tmpSum += z[row];
+				if (rowMeans != NULL)
+					tmpDot += rowMeans[row] * z[row];
+			}
+			columnSum[ex] = tmpSum;
+			rowMeansDot[ex] = tmpDot;
+		}
+	}
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,64)
+#endif
+	for (int col = 0; col < n; col++) {
+		const F mean = (means == NULL) ? 0 : means[col];
+		for (int exStart = 0; exStart < experiments; exStart +=
+				SPARSE_EXPERIMENTS_BLOCK) {
+			const int block = std::min(SPARSE_EXPERIMENTS_BLOCK,
+					experiments - exStart);
+			const F* z = &Z[(long long) exStart * m];
+			F acc[SPARSE_EXPERIMENTS_BLOCK];
+			for (int b = 0; b < block; b++)
+				acc[b] = -mean * columnSum[exStart + b]
+						- rowMeansDot[exStart + b];
+			for (I k = colPtr[col]; k < colPtr[col + 1]; k++) {
+				const F val = vals[k];
+				const F* zRow = &z[rowId[k]];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+				for (int b = 0; b < block; b++)
+					acc[b] += val * zRow[(long long) b * m];
+			}
+			for (int b = 0; b < block; b++)
+				V[col + (long long) (exStart + b) * n] = acc[b];
+		}
+	}
 }
 
-void sparse_matrix_matrix_multiply(char *transa, int mI, int nI, int kI,
-		float *alpha, char *matdescra, float *val, MKL_INT *indx,
-		MKL_INT *pntrb, MKL_INT *pntre, float *b, int ldbI, float *beta,
-		float *c, int ldcI) {
-
-	MKL_INT m = mI;
-	MKL_INT n = nI;
-	MKL_INT k = kI;
-	MKL_INT ldc = ldcI;
-	MKL_INT ldb = ldbI;
-
-	mkl_scscmm(transa, &m, &n, &k, alpha, matdescra, val, indx, pntrb, pntre, b,
-			&ldb, beta, c, &ldc);
+/*
+ * Multiplication by implicitly mean-centered matrix (B - 1*means'), where B is
+ * stored in CSC format without centering:
+ *   trans == false:  y = B*x - 1*(means'*x)      x is n x experiments
+ *   trans == true:   y = B'*x - means*(1'*x)     x is m x experiments
+ * Cost is proportional to nnz(B) (plus O((m+n) experiments) for the rank-one
+ * terms), the zeros of B are never visited.
+ */
+template<typename F>
+void my_mm_multiply(bool trans, const int m, const int n, const int experiments,
+		const F* vals, const int* row_id, const int* colPtr, const F* means,
+		F* x, F*y) {
+	if (trans) {
+		sparse_matrix_transposed_dense_block_multiply(m, n, experiments, vals,
+				row_id, colPtr, means, (const F*) NULL, x, y);
+	} else {
+		sparse_matrix_dense_block_multiply(m, n, experiments, vals, row_id,
+				colPtr, (const F*) NULL, (const int*) NULL, (const int*) NULL,
+				means, (const F*) NULL, x, y);
+	}
 }
+
 #endif /* MY_CBLAS_WRAPPER_H_ */
@@ -16,6 +16,7 @@
 #define SPARSE_PCA_SOLVER_H_
 #include "../class/optimization_settings.h"
 #include "../class/optimization_statistics.h"
+#include "../class/solver_workspace.h"
 #include "../utils/various.h"
 #include "../utils/thresh_functions.h"
 #include "../utils/timer.h"
@@ -29,218 +30,635 @@
 
 /*
  * Matrix B is stored in column order (Fortran Based)
+ *
+ * L2 formulations may iterate on Gram matrix B'B (see denseDataSolver).
+ *
+ * If workspace is given, its memory is used (and grown if needed) instead of
+ * allocating new one, so it can be reused by consecutive calls.
+ *
+ * If deflation is given (and not empty), the problem is solved for
+ * B (I - QQ') where Q are its (orthonormalized) components.
+ *
+ * If parameters are given, the problem is solved for each of P values of
+ * constraintParameter (constrained) or penaltyParameter (penalized) at once:
+ * point g uses starting point g / P and value g % P, so every value gets
+ * totalStartingPoints points and all of them share the GEMMs. The best
+ * solution for value p is stored into column p of x (n x P) and its objective
+ * value into values[p]; logs of all points are indexed by g.
+ *
+ * A constrained problem with cardinality 0 (constraintParameter or one of the
+ * parameters below 1) is rejected: -1 is returned and x is not changed.
  */
 
 namespace SPCASolver {
 namespace MulticoreSolver {
-template<typename F>
-F denseDataSolver(const F * B, const int ldB, F * x, const unsigned int m,
-		const unsigned int n,
+/*
+ * Solver for dense B (m x n) or, if "gram" is set, for its Gram matrix
+ * G = B'B given as B (n x n, m is not used). Matrix is F,
+ * ReducedPrecisionMatrix<F> or StreamedMatrix<F> (see data_matrix.h).
+ * Instantiated for optimizationSettings->formulation, see dense_solver.
+ */
+template<SolverStructures::SPCA_Formulation formulation, typename F,
+		typename Matrix>
+F formulation_dense_solver(const Matrix * B, const int ldB, const bool gram, F * x,
+		const unsigned int m, const unsigned int n,
 		SolverStructures::OptimizationSettings* optimizationSettings,
-		SolverStructures::OptimizationStatistics* optimizationStatistics) {
+		SolverStructures::OptimizationStatistics* optimizationStatistics,
+		SolverStructures::SolverWorkspace<F>* workspace,
+		SparseDeflationCollection<F>* deflation,
+		const std::vector<double>* parameters, F* values) {
 #ifdef _OPENMP
 #pragma omp parallel
 	{
 		optimizationStatistics->totalThreadsUsed = omp_get_num_threads();
 	}
 #endif
+	// GEMMs are called from serial code, BLAS gets all cores
+	SolverStructures::set_blas_threads(
+			SolverStructures::ExecutionPolicy::cores());
 
 	if (optimizationSettings->verbose) {
 //		cout << "Solver started " << endl;
 	}
-	optimizationSettings->chceckInputAndModifyIt(n);
+	const bool constrained =
+			SolverStructures::FormulationTraits<formulation>::constrained;
+	const unsigned int P = (parameters == NULL) ? 1 : parameters->size();
+	std::vector<double> columnParameters;
+	const unsigned int constraintParameter =
+			optimizationSettings->constraintParameter;
+	bool validInput = true;
+	if (parameters != NULL && constrained) {
+		// candidates of starting point heuristics are chosen for largest value
+		optimizationSettings->constraintParameter = 0;
+		for (unsigned int p = 0; p < P; p++) {
+			validInput = validInput && (unsigned int) (*parameters)[p] > 0;
+			optimizationSettings->constraintParameter = std::max(
+					optimizationSettings->constraintParameter,
+					std::min((unsigned int) (*parameters)[p], n));
+		}
+	}
+	if (!validInput || !optimizationSettings->chceckInputAndModifyIt(n)) {
+		optimizationSettings->constraintParameter = constraintParameter;
+		optimizationStatistics->it = 0;
+		optimizationStatistics->fval = -1;
+		return -1;
+	}
 	optimizationStatistics->it = optimizationSettings->maximumIterations;
 	F FLOATING_ZERO = 0;
 	// Allocate vector for optimizationStatistics to return which point needs how much iterations
 	if (optimizationSettings->storeIterationsForAllPoints) {
 		optimizationStatistics->iters.resize(
-				optimizationSettings->totalStartingPoints, -1);
+				optimizationSettings->totalStartingPoints * P, -1);
 		optimizationStatistics->cardinalities.resize(
-				optimizationSettings->totalStartingPoints, -1);
+				optimizationSettings->totalStartingPoints * P, -1);
 		optimizationStatistics->values.resize(
-				optimizationSettings->totalStartingPoints, -1);
+				optimizationSettings->totalStartingPoints * P, -1);
 
 	}
 	const unsigned int number_of_experiments_per_batch =
 			optimizationSettings->batchSize;
-	F * Z = (F*) calloc(m * number_of_experiments_per_batch, sizeof(F));
-	ValueCoordinateHolder<F>* vals = (ValueCoordinateHolder<F>*) calloc(
-			number_of_experiments_per_batch, sizeof(ValueCoordinateHolder<F> ));
-	F * V = (F*) calloc(n * number_of_experiments_per_batch, sizeof(F));
-	optimizationStatistics->totalTrueComputationTime = 0;
-	F error = 0;
-	F max_errors[TOTAL_THREADS];
-	std::vector<F>* buffer = (std::vector<F>*) calloc(
-			number_of_experiments_per_batch, sizeof(std::vector<F>));
-	if (optimizationSettings->isConstrainedProblem()) {
-		for (unsigned int j = 0; j < number_of_experiments_per_batch; j++) {
-			buffer[j].resize(n);
-		}
+	// rows of Z = B*V, for Gram matrix Z holds G*V
+	const unsigned int rows = gram ? n : m;
+	if (deflation != NULL && deflation->empty())
+		deflation = NULL;
+	// with packed signs only one panel of Z is formed at a time
+	const unsigned int packedRows =
+			gram ? 0 : packed_sign_rows<formulation>(optimizationSettings, m,
+							n, B, deflation != NULL,
+							optimizationSettings->useActiveSet && constrained);
+	workspace->prepare((packedRows > 0) ? packedRows : rows, n,
+			number_of_experiments_per_batch, constrained);
+	SolverStructures::SignMatrix* signs =
+			(packedRows > 0) ? &workspace->signs : NULL;
+	F * Z = workspace->Z.data;
+	F * V = workspace->V.data;
+	F * product = gram ? NULL : workspace->product.reserve(
+			(size_t) n * number_of_experiments_per_batch);
+	ValueCoordinateHolder<F>* vals = &workspace->vals[0];
+	std::vector<F>* buffer = workspace->getBuffers();
+	SolverStructures::ActiveSetV<F>* activeSet = NULL;
+	if (optimizationSettings->useActiveSet && constrained) {
+		activeSet = &workspace->activeSet;
+		activeSet->prepare(n, number_of_experiments_per_batch);
+	}
+	if (deflation != NULL) {
+		// image of previous components, B*Q (G*Q)
+		std::vector<F> Q((size_t) n * deflation->components);
+		deflation->getDenseComponents(&Q[0], n);
+		deflation->BQ.resize((size_t) rows * deflation->components);
+		data_matrix_multiply(CblasNoTrans, rows, n, deflation->components, B,
+				ldB, &Q[0], n, &deflation->BQ[0], rows);
 	}
+	/*
+	 * Starting points are processed in slots (columns of V). A point is
+	 * retired as soon as it converges (or reaches maximumIterations) and live
+	 * columns are compacted to the front, so both GEMMs shrink. With useOTF a
+	 * free slot is immediately refilled with a new point, otherwise the next
+	 * batch starts when all points of the current one are retired. Every point
+	 * is iterated the same way in both modes, so (with counter based starting
+	 * points) the result does not depend on batchSize or useOTF.
+	 * Iterations of every point are logged here (slots do not correspond to
+	 * points).
+	 */
+	const bool storeIterationsForAllPoints =
+			optimizationSettings->storeIterationsForAllPoints;
+	optimizationSettings->storeIterationsForAllPoints = false;
+	const unsigned int totalStartingPoints =
+			optimizationSettings->totalStartingPoints * P;
+	F max_errors[TOTAL_THREADS];
 	F the_best_solution_value = -1;
+	std::vector<F> best_values(P, -1);
+	if (parameters != NULL) {
+		columnParameters.resize(number_of_experiments_per_batch);
+		for (unsigned int p = 0; p < P; p++)
+			cblas_vector_scale(n, &x[(size_t) n * p], FLOATING_ZERO);
+	}
 	unsigned int total_iterations = 0;
-	optimizationStatistics->it = 0;
-	if (optimizationSettings->useOTF) {
-		optimizationSettings->storeIterationsForAllPoints = false;
-		cblas_vector_scale(n * number_of_experiments_per_batch, V,
-				FLOATING_ZERO);
-		initialize_totalStartingPoints(V, Z, optimizationSettings,
-				optimizationStatistics, number_of_experiments_per_batch, n, m,
-				ldB, B, 0);
-		unsigned int generated_points = number_of_experiments_per_batch;
-		bool do_iterate = true;
-		unsigned int optimizationStatisticsistical_shift = 0;
-
-		std::vector<unsigned int> current_iteration(
-				number_of_experiments_per_batch, 0);
-		std::vector<unsigned int> current_order(number_of_experiments_per_batch,
-				0);
-		for (unsigned int i = 0; i < number_of_experiments_per_batch; i++) {
-			current_order[i] = i;
-		}
-		double start_time_of_iterations = gettime();
-		while (do_iterate) {
-			total_iterations++;
-			for (unsigned int tmp = 0; tmp < TOTAL_THREADS; tmp++) {
-				max_errors[tmp] = 0;
-			}
-			if (optimizationSettings->isConstrainedProblem()) {
-				perform_one_iteration_for_constrained_pca(V, Z,
-						optimizationSettings, optimizationStatistics,
-						number_of_experiments_per_batch, n, m, ldB, B,
-						max_errors, vals, buffer, 0,
-						optimizationStatisticsistical_shift);
-			} else {
-				perform_one_iteration_for_penalized_pca(V, Z,
-						optimizationSettings, optimizationStatistics,
-						number_of_experiments_per_batch, n, m, ldB, B,
-						max_errors, vals, 0,
-						optimizationStatisticsistical_shift);
+	std::vector<unsigned int> slot_point(number_of_experiments_per_batch);
+	std::vector<unsigned int> slot_iteration(number_of_experiments_per_batch);
+	unsigned int generated_points = 0;
+	unsigned int live = 0;
+	double start_time_of_iterations = gettime();
+	StartingPointHeuristics<F> heuristics;
+	if (gram)
+		prepare_gram_starting_points(heuristics, B, ldB, n,
+				optimizationSettings);
+	else
+		prepare_dense_starting_points(heuristics, B, ldB, m, n,
+				optimizationSettings);
+	// first "batchSize" points can start from final points of previous solve
+	// (they are all generated before any point is retired and overwrites them)
+	F* warmV = workspace->warmV.reserve((size_t) n * number_of_experiments_per_batch);
+	bool warmStart = workspace->useWarmStart && workspace->warmN == n
+			&& workspace->warmValues.size() == number_of_experiments_per_batch;
+	std::vector<F> warmValues;
+	warmValues.swap(workspace->warmValues);
+	workspace->warmValues.assign(number_of_experiments_per_batch, -1);
+	workspace->warmN = n;
+	while (true) {
+		if (optimizationSettings->useOTF || live == 0) {
+			// fill free slots with new starting points
+			const unsigned int first_new = live;
+			while (live < number_of_experiments_per_batch
+					&& generated_points < totalStartingPoints) {
+				slot_point[live] = generated_points;
+				slot_iteration[live] = 0;
+				if (parameters != NULL)
+					columnParameters[live] = (*parameters)[generated_points % P];
+				vals[live].reset();
+				generated_points++;
+				live++;
 			}
-
-			do_iterate = false;
-			unsigned int number_of_new_points = 0;
-			for (unsigned int i = 0; i < number_of_experiments_per_batch; i++) {
-				current_iteration[i]++;
-				if (termination_criteria(vals[i].current_error,
-						current_iteration[i], optimizationSettings)
-						|| current_iteration[i]
-								>= optimizationSettings->maximumIterations) {
-					// this point reached it convergence criterion, optimizationStatistics again....
-					if (the_best_solution_value < vals[i].val) {
-						the_best_solution_value = vals[i].val;
-						cblas_vector_copy(n, &V[n * i], 1, x, 1);
-					}
-					if (generated_points
-							< optimizationSettings->totalStartingPoints) {
-						vals[i].reset();
-						current_order[i] = generated_points;
-						number_of_new_points++;
-						generated_points++;
-						current_iteration[i] = 0;
-						do_iterate = true;
-					}
-				} else {
-					do_iterate = true;
-				}
-			}
-			if (number_of_new_points > 0) {
-				// generate new points in parallel
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-				for (unsigned int j = 0; j < number_of_experiments_per_batch;
-						j++) {
-					if (current_iteration[j] == 0) {
-						if (optimizationSettings->isConstrainedProblem()) {
-							cblas_vector_scale(n, &V[j * n], FLOATING_ZERO);
-						}
-						getSignleStartingPoint(&V[j * n], &Z[j * m],
-								optimizationSettings, n, m, current_order[j],
-								0);
+			for (unsigned int j = first_new; j < live; j++) {
+				if (warmStart && warmValues[slot_point[j]] > 0) {
+					cblas_vector_copy(n, &warmV[(size_t) n * slot_point[j]], 1,
+							&V[j * n], 1);
+				} else {
+					if (constrained) {
+						cblas_vector_scale(n, &V[j * n], FLOATING_ZERO);
 					}
+					getSignleStartingPoint(&V[j * n], optimizationSettings,
+							n, 0, slot_point[j] / P,
+							&heuristics,
+							(parameters != NULL && constrained) ?
+									std::min((unsigned int) columnParameters[j], n) : 0);
 				}
+				if (activeSet != NULL)
+					activeSet->compressColumn(&V[j * n], n, j);
 			}
-
+			warmStart = false;
 		}
-		double end_time_of_iterations = gettime();
-		optimizationStatistics->totalTrueComputationTime +=
-				(end_time_of_iterations - start_time_of_iterations);
-	} else {
-		//====================== MAIN LOOP THROUGHT BATCHES
-		for (unsigned int batch = 0; batch < optimizationSettings->totalBatches;
-				batch++) {
-			unsigned int optimizationStatisticsistical_shift = batch
-					* optimizationSettings->batchSize;
-			cblas_vector_scale(n * number_of_experiments_per_batch, V,
-					FLOATING_ZERO);
-			initialize_totalStartingPoints(V, Z, optimizationSettings,
-					optimizationStatistics, number_of_experiments_per_batch, n,
-					m, ldB, B, optimizationStatisticsistical_shift);
-			for (unsigned int j = 0; j < number_of_experiments_per_batch; j++) {
-				vals[j].reset();
-			}
-			double start_time_of_iterations = gettime();
-			for (unsigned int it = 0;
-					it < optimizationSettings->maximumIterations; it++) {
-				total_iterations++;
-				for (unsigned int tmp = 0; tmp < TOTAL_THREADS; tmp++) {
-					max_errors[tmp] = 0;
-				}
-				if (optimizationSettings->isConstrainedProblem()) {
-					perform_one_iteration_for_constrained_pca(V, Z,
-							optimizationSettings, optimizationStatistics,
-							number_of_experiments_per_batch, n, m, ldB, B,
-							max_errors, vals, buffer, it,
-							optimizationStatisticsistical_shift);
-				} else {
-					perform_one_iteration_for_penalized_pca(V, Z,
-							optimizationSettings, optimizationStatistics,
-							number_of_experiments_per_batch, n, m, ldB, B,
-							max_errors, vals, it,
-							optimizationStatisticsistical_shift);
-				}
-				error = max_errors[cblas_vector_max_index(TOTAL_THREADS,
-						max_errors, 1)];
-				if (termination_criteria(error, it, optimizationSettings)) {
-					break;
+		if (live == 0)
+			break;
+		total_iterations++;
+		for (unsigned int tmp = 0; tmp < TOTAL_THREADS; tmp++) {
+			max_errors[tmp] = 0;
+		}
+		// live points shrink as they are retired, threading is decided again
+		optimizationSettings->executionPolicy.decide(
+				optimizationSettings->threadingMode, live, rows, n, constrained);
+		// "it" is used only for logging, which is done on retirement here
+		const double* slot_parameters =
+				(parameters == NULL) ? NULL : &columnParameters[0];
+		if (gram) {
+			perform_one_iteration_with_gram_matrix<formulation>(V, Z,
+					optimizationSettings, optimizationStatistics, live, n, ldB,
+					B, max_errors, vals, buffer, total_iterations - 1, 0,
+					activeSet, deflation, slot_parameters);
+		} else if (constrained) {
+			perform_one_iteration_for_constrained_pca<formulation>(V, Z,
+					optimizationSettings, optimizationStatistics, live, n, m,
+					ldB, B, max_errors, vals, buffer, total_iterations - 1, 0,
+					activeSet, deflation, slot_parameters, product, signs);
+		} else {
+			perform_one_iteration_for_penalized_pca<formulation>(V, Z,
+					optimizationSettings, optimizationStatistics, live, n, m,
+					ldB, B, max_errors, vals, total_iterations - 1, 0,
+					deflation, slot_parameters, product, signs);
+		}
+		unsigned int kept = 0;
+		for (unsigned int i = 0; i < live; i++) {
+			const unsigned int it = slot_iteration[i];
+			const bool converged = termination_criteria(vals[i].current_error,
+					it, optimizationSettings);
+			if (converged || it + 1 >= (unsigned int)
+					optimizationSettings->maximumIterations) {
+				const unsigned int p = slot_point[i] % P;
+				retire_starting_point(&V[n * i], vals[i].val, &x[(size_t) n * p],
+						best_values[p], n, converged ? (int) it : -1,
+						storeIterationsForAllPoints, optimizationStatistics,
+						slot_point[i]);
+				const unsigned int warm = slot_point[i]
+						% number_of_experiments_per_batch;
+				if (workspace->warmValues[warm] < vals[i].val) {
+					workspace->warmValues[warm] = vals[i].val;
+					cblas_vector_copy(n, &V[n * i], 1, &warmV[(size_t) n * warm],
+							1);
 				}
-			}
-			double end_time_of_iterations = gettime();
-			optimizationStatistics->totalTrueComputationTime +=
-					(end_time_of_iterations - start_time_of_iterations);
-			//============= save the best solution==========
-			int selected_idx = 0;
-			F best_value = vals[selected_idx].val;
-			if (optimizationSettings->storeIterationsForAllPoints)
-				optimizationStatistics->values[0
-						+ optimizationStatisticsistical_shift] = best_value;
-			for (unsigned int i = 1; i < number_of_experiments_per_batch; i++) {
-				if (optimizationSettings->storeIterationsForAllPoints)
-					optimizationStatistics->values[i
-							+ optimizationStatisticsistical_shift] =
-							vals[i].val;
-				if (vals[i].val > best_value) {
-					best_value = vals[i].val;
-					selected_idx = i;
+			} else {
+				if (kept != i) {
+					cblas_vector_copy(n, &V[n * i], 1, &V[n * kept], 1);
+					vals[kept] = vals[i];
+					slot_point[kept] = slot_point[i];
+					if (parameters != NULL)
+						columnParameters[kept] = columnParameters[i];
+					if (activeSet != NULL)
+						activeSet->moveColumn(i, kept);
 				}
-			}
-			if (the_best_solution_value < best_value) { //if this batch gives better value, store "x"
-				the_best_solution_value = best_value;
-				cblas_vector_copy(n, &V[n * selected_idx], 1, x, 1);
+				slot_iteration[kept] = it + 1;
+				kept++;
 			}
 		}
+		live = kept;
 	}
+	double end_time_of_iterations = gettime();
+	optimizationStatistics->totalTrueComputationTime =
+			(end_time_of_iterations - start_time_of_iterations);
+	optimizationSettings->executionPolicy = SolverStructures::ExecutionPolicy();
+	optimizationSettings->storeIterationsForAllPoints =
+			storeIterationsForAllPoints;
 	optimizationStatistics->it = total_iterations;
+	if (parameters != NULL)
+		optimizationSettings->constraintParameter = constraintParameter;
 	//compute corresponding x
-	F norm_of_x = cblas_l2_norm(n, x, 1);
-	cblas_vector_scale(n, x, 1 / norm_of_x); //Final x
-	free(Z);
-	free(V);
-	free(vals);
+	for (unsigned int p = 0; p < P; p++) {
+		F norm_of_x = cblas_l2_norm(n, &x[(size_t) n * p], 1);
+		cblas_vector_scale(n, &x[(size_t) n * p], 1 / norm_of_x); //Final x
+		if (values != NULL)
+			values[p] = best_values[p];
+		if (the_best_solution_value < best_values[p])
+			the_best_solution_value = best_values[p];
+	}
 	optimizationStatistics->fval = the_best_solution_value;
 	return the_best_solution_value;
 }
+
+/*
+ * The only test of the formulation at run time: every formulation (for both
+ * precisions) has its own instance of the solver and of the iterations.
+ */
+template<typename F, typename Matrix>
+F dense_solver(const Matrix * B, const int ldB, const bool gram, F * x,
+		const unsigned int m, const unsigned int n,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		SolverStructures::OptimizationStatistics* optimizationStatistics,
+		SolverStructures::SolverWorkspace<F>* workspace,
+		SparseDeflationCollection<F>* deflation,
+		const std::vector<double>* parameters, F* values) {
+	switch (optimizationSettings->formulation) {
+	case SolverStructures::L0_constrained_L2_PCA:
+		return formulation_dense_solver<SolverStructures::L0_constrained_L2_PCA>(
+				B, ldB, gram, x, m, n, optimizationSettings,
+				optimizationStatistics, workspace, deflation, parameters, values);
+	case SolverStructures::L0_constrained_L1_PCA:
+		return formulation_dense_solver<SolverStructures::L0_constrained_L1_PCA>(
+				B, ldB, gram, x, m, n, optimizationSettings,
+				optimizationStatistics, workspace, deflation, parameters, values);
+	case SolverStructures::L1_constrained_L2_PCA:
+		return formulation_dense_solver<SolverStructures::L1_constrained_L2_PCA>(
+				B, ldB, gram, x, m, n, optimizationSettings,
+				optimizationStatistics, workspace, deflation, parameters, values);
+	case SolverStructures::L1_constrained_L1_PCA:
+		return formulation_dense_solver<SolverStructures::L1_constrained_L1_PCA>(
+				B, ldB, gram, x, m, n, optimizationSettings,
+				optimizationStatistics, workspace, deflation, parameters, values);
+	case SolverStructures::L0_penalized_L2_PCA:
+		return formulation_dense_solver<SolverStructures::L0_penalized_L2_PCA>(
+				B, ldB, gram, x, m, n, optimizationSettings,
+				optimizationStatistics, workspace, deflation, parameters, values);
+	case SolverStructures::L0_penalized_L1_PCA:
+		return formulation_dense_solver<SolverStructures::L0_penalized_L1_PCA>(
+				B, ldB, gram, x, m, n, optimizationSettings,
+				optimizationStatistics, workspace, deflation, parameters, values);
+	case SolverStructures::L1_penalized_L2_PCA:
+		return formulation_dense_solver<SolverStructures::L1_penalized_L2_PCA>(
+				B, ldB, gram, x, m, n, optimizationSettings,
+				optimizationStatistics, workspace, deflation, parameters, values);
+	case SolverStructures::L1_penalized_L1_PCA:
+		return formulation_dense_solver<SolverStructures::L1_penalized_L1_PCA>(
+				B, ldB, gram, x, m, n, optimizationSettings,
+				optimizationStatistics, workspace, deflation, parameters, values);
+	}
+	return -1;
+}
+
+/*
+ * L2 formulations can iterate on G = B'B instead of B (see use_gram_matrix
+ * and optimizationSettings->gramMatrixMode). G is kept in the workspace, so
+ * consecutive calls with the same B form it only once (if
+ * workspace->sameData is set, see SolverWorkspace); time of forming G is
+ * included in totalTrueComputationTime.
+ */
+template<typename F>
+F denseDataSolver(const F * B, const int ldB, F * x, const unsigned int m,
+		const unsigned int n,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		SolverStructures::OptimizationStatistics* optimizationStatistics,
+		SolverStructures::SolverWorkspace<F>* workspace = NULL,
+		SparseDeflationCollection<F>* deflation = NULL,
+		const std::vector<double>* parameters = NULL, F* values = NULL) {
+	SolverStructures::SolverWorkspace<F> localWorkspace;
+	if (workspace == NULL)
+		workspace = &localWorkspace;
+	if (!use_gram_matrix<F>(optimizationSettings, m, n,
+			(parameters == NULL) ? 1 : parameters->size())) {
+		return dense_solver(B, ldB, false, x, m, n, optimizationSettings,
+				optimizationStatistics, workspace, deflation, parameters,
+				values);
+	}
+	double gram_time = 0;
+	if (!workspace->sameData)
+		workspace->invalidate();
+	if (workspace->gramSource != B || workspace->gramM != m
+			|| workspace->gramN != n) {
+		double start_time = gettime();
+		compute_gram_matrix(B, ldB, m, n,
+				workspace->gram.reserve((size_t) n * n));
+		workspace->gramSource = B;
+		workspace->gramM = m;
+		workspace->gramN = n;
+		gram_time = gettime() - start_time;
+	}
+	F value = dense_solver((const F*) workspace->gram.data, n, true, x, m, n,
+			optimizationSettings, optimizationStatistics, workspace,
+			deflation, parameters, values);
+	optimizationStatistics->totalTrueComputationTime += gram_time;
+	return value;
+}
+
+/*
+ * Solver for a precomputed Gram (covariance) matrix G = B'B (n x n, leading
+ * dimension ldG, both triangles), e.g. when B is never stored. Only L2
+ * formulations are defined by G alone; for L1 formulations -1 is returned.
+ */
+template<typename F>
+F gramDataSolver(const F * G, const int ldG, F * x, const unsigned int n,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		SolverStructures::OptimizationStatistics* optimizationStatistics,
+		SolverStructures::SolverWorkspace<F>* workspace = NULL,
+		SparseDeflationCollection<F>* deflation = NULL,
+		const std::vector<double>* parameters = NULL, F* values = NULL) {
+	if (!optimizationSettings->isL2Problem())
+		return -1;
+	SolverStructures::SolverWorkspace<F> localWorkspace;
+	if (workspace == NULL)
+		workspace = &localWorkspace;
+	return dense_solver(G, ldG, true, x, n, n, optimizationSettings,
+			optimizationStatistics, workspace, deflation, parameters, values);
+}
+
+/*
+ * Solver for B stored in 16 bits per entry (bfloat16 or fp16); tiles of B are
+ * decoded on the fly and all products are accumulated in precision F. Gram
+ * matrix mode is not used.
+ */
+template<typename F>
+F reducedPrecisionSolver(const SolverStructures::ReducedPrecisionMatrix<F>& B,
+		F * x, SolverStructures::OptimizationSettings* optimizationSettings,
+		SolverStructures::OptimizationStatistics* optimizationStatistics,
+		SolverStructures::SolverWorkspace<F>* workspace = NULL,
+		SparseDeflationCollection<F>* deflation = NULL,
+		const std::vector<double>* parameters = NULL, F* values = NULL) {
+	SolverStructures::SolverWorkspace<F> localWorkspace;
+	if (workspace == NULL)
+		workspace = &localWorkspace;
+	return dense_solver(&B, B.m, false, x, B.m, B.n, optimizationSettings,
+			optimizationStatistics, workspace, deflation, parameters, values);
+}
+
+/*
+ * Solver for B which does not fit into memory, read from a binary matrix file
+ * in row panels (see streamed_matrix.h); every iteration reads the file once
+ * for all points of the batch while the next panel is prefetched. Gram matrix
+ * mode and deflation are not used. Returns -1 if the file could not be read.
+ */
+template<typename F>
+F streamedDataSolver(const InputOuputHelper::StreamedMatrix<F>& B, F * x,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		SolverStructures::OptimizationStatistics* optimizationStatistics,
+		SolverStructures::SolverWorkspace<F>* workspace = NULL,
+		const std::vector<double>* parameters = NULL, F* values = NULL) {
+	SolverStructures::SolverWorkspace<F> localWorkspace;
+	if (workspace == NULL)
+		workspace = &localWorkspace;
+	F value = dense_solver(&B, B.m, false, x, B.m, B.n, optimizationSettings,
+			optimizationStatistics, workspace,
+			(SparseDeflationCollection<F>*) NULL, parameters, values);
+	return (B.status() == 0) ? value : -1;
+}
+
+/*
+ * Objective value of given x (length n, unit norm) for dense B, computed the
+ * same way as the solver does it (for penalized formulations it is the value
+ * after one more thresholding, equal at convergence). Used to check solutions
+ * computed from reduced precision B against full precision data.
+ */
+template<SolverStructures::SPCA_Formulation formulation, typename F>
+F evaluate_solution(const F * B, const int ldB, const F * x,
+		const unsigned int m, const unsigned int n,
+		SolverStructures::OptimizationSettings* optimizationSettings) {
+	const bool constrained =
+			SolverStructures::FormulationTraits<formulation>::constrained;
+	SolverStructures::SolverWorkspace<F> workspace;
+	workspace.prepare(m, n, 1, constrained);
+	SolverStructures::OptimizationStatistics optimizationStatistics;
+	const bool storeIterationsForAllPoints =
+			optimizationSettings->storeIterationsForAllPoints;
+	optimizationSettings->storeIterationsForAllPoints = false;
+	F max_errors[TOTAL_THREADS];
+	for (unsigned int tmp = 0; tmp < TOTAL_THREADS; tmp++)
+		max_errors[tmp] = 0;
+	F* V = workspace.V.data;
+	cblas_vector_copy(n, x, 1, V, 1);
+	if (constrained) {
+		perform_one_iteration_for_constrained_pca<formulation>(V,
+				workspace.Z.data, optimizationSettings, &optimizationStatistics,
+				1, n, m, ldB, B, max_errors, &workspace.vals[0],
+				workspace.getBuffers(), 0, 0);
+	} else {
+		perform_one_iteration_for_penalized_pca<formulation>(V,
+				workspace.Z.data, optimizationSettings, &optimizationStatistics,
+				1, n, m, ldB, B, max_errors, &workspace.vals[0], 0, 0);
+	}
+	optimizationSettings->storeIterationsForAllPoints =
+			storeIterationsForAllPoints;
+	return workspace.vals[0].val;
+}
+
+template<typename F>
+F evaluateSolution(const F * B, const int ldB, const F * x,
+		const unsigned int m, const unsigned int n,
+		SolverStructures::OptimizationSettings* optimizationSettings) {
+	switch (optimizationSettings->formulation) {
+	case SolverStructures::L0_constrained_L2_PCA:
+		return evaluate_solution<SolverStructures::L0_constrained_L2_PCA>(B,
+				ldB, x, m, n, optimizationSettings);
+	case SolverStructures::L0_constrained_L1_PCA:
+		return evaluate_solution<SolverStructures::L0_constrained_L1_PCA>(B,
+				ldB, x, m, n, optimizationSettings);
+	case SolverStructures::L1_constrained_L2_PCA:
+		return evaluate_solution<SolverStructures::L1_constrained_L2_PCA>(B,
+				ldB, x, m, n, optimizationSettings);
+	case SolverStructures::L1_constrained_L1_PCA:
+		return evaluate_solution<SolverStructures::L1_constrained_L1_PCA>(B,
+				ldB, x, m, n, optimizationSettings);
+	case SolverStructures::L0_penalized_L2_PCA:
+		return evaluate_solution<SolverStructures::L0_penalized_L2_PCA>(B,
+				ldB, x, m, n, optimizationSettings);
+	case SolverStructures::L0_penalized_L1_PCA:
+		return evaluate_solution<SolverStructures::L0_penalized_L1_PCA>(B,
+				ldB, x, m, n, optimizationSettings);
+	case SolverStructures::L1_penalized_L2_PCA:
+		return evaluate_solution<SolverStructures::L1_penalized_L2_PCA>(B,
+				ldB, x, m, n, optimizationSettings);
+	case SolverStructures::L1_penalized_L1_PCA:
+		return evaluate_solution<SolverStructures::L1_penalized_L1_PCA>(B,
+				ldB, x, m, n, optimizationSettings);
+	}
+	return -1;
+}
+
+/*
+ * Regularization path: solves the problem for every value of "parameters"
+ * (constraintParameter for constrained, penaltyParameter for penalized
+ * formulations) in the given order and stores solution i into column i of X
+ * (n x parameters.size()) and its statistics into statistics[i]. Every solve
+ * starts from the best final points of the previous one (see
+ * SolverWorkspace::warmV), which are close to the new solutions along the
+ * path. Workspace is shared by all solves.
+ */
+template<typename F>
+void solvePath(const F * B, const int ldB, F * X, const unsigned int m,
+		const unsigned int n, const std::vector<double>& parameters,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		std::vector<SolverStructures::OptimizationStatistics>& statistics,
+		SolverStructures::SolverWorkspace<F>* workspace = NULL) {
+	SolverStructures::SolverWorkspace<F> localWorkspace;
+	if (workspace == NULL)
+		workspace = &localWorkspace;
+	const unsigned int constraintParameter =
+			optimizationSettings->constraintParameter;
+	const double penaltyParameter = optimizationSettings->penaltyParameter;
+	statistics.resize(parameters.size());
+	workspace->useWarmStart = false;
+	const bool sameData = workspace->sameData;
+	for (unsigned int i = 0; i < parameters.size(); i++) {
+		if (optimizationSettings->isConstrainedProblem()) {
+			optimizationSettings->constraintParameter =
+					(unsigned int) parameters[i];
+		} else {
+			optimizationSettings->penaltyParameter = parameters[i];
+		}
+		denseDataSolver(B, ldB, &X[(size_t) n * i], m, n, optimizationSettings,
+				&statistics[i], workspace);
+		workspace->useWarmStart = true;
+		workspace->sameData = true;
+	}
+	workspace->useWarmStart = false;
+	workspace->sameData = sameData;
+	optimizationSettings->constraintParameter = constraintParameter;
+	optimizationSettings->penaltyParameter = penaltyParameter;
+}
+
+/*
+ * Solves the problem for all values of "parameters" in shared batches (see
+ * denseDataSolver), so a sweep runs as one wide-GEMM workload instead of
+ * parameters.size() narrow ones. Solution for value i goes to column i of X
+ * (n x parameters.size()); statistics[i] holds its objective value and the
+ * logs of its points, iterations and time are those of the shared run.
+ */
+template<typename F>
+void solveParameterBatch(const F * B, const int ldB, F * X,
+		const unsigned int m, const unsigned int n,
+		const std::vector<double>& parameters,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		std::vector<SolverStructures::OptimizationStatistics>& statistics,
+		SolverStructures::SolverWorkspace<F>* workspace = NULL) {
+	const unsigned int P = parameters.size();
+	SolverStructures::OptimizationStatistics shared;
+	std::vector<F> values(P, -1);
+	denseDataSolver(B, ldB, X, m, n, optimizationSettings, &shared, workspace,
+			(SparseDeflationCollection<F>*) NULL, &parameters, &values[0]);
+	statistics.resize(P);
+	for (unsigned int i = 0; i < P; i++) {
+		statistics[i].it = shared.it;
+		statistics[i].fval = values[i];
+		statistics[i].totalTrueComputationTime = shared.totalTrueComputationTime;
+		statistics[i].totalThreadsUsed = shared.totalThreadsUsed;
+		statistics[i].n = n;
+		if (optimizationSettings->storeIterationsForAllPoints) {
+			const unsigned int points = shared.values.size() / P;
+			statistics[i].values.resize(points);
+			statistics[i].iters.resize(points);
+			statistics[i].cardinalities.resize(points);
+			for (unsigned int s = 0; s < points; s++) {
+				statistics[i].values[s] = shared.values[s * P + i];
+				statistics[i].iters[s] = shared.iters[s * P + i];
+				statistics[i].cardinalities[s] = shared.cardinalities[s * P + i];
+			}
+		}
+	}
+}
+
+/*
+ * Computes r sparse components of B into columns of X (n x r). Component c
+ * is the solution for B (I - QQ'), where Q are the previous components
+ * orthonormalized. Workspace is shared by all components.
+ *
+ * optimizationStatistics describe the last component, "it" and
+ * totalTrueComputationTime are totals and componentValues holds the objective
+ * value of every component.
+ */
+template<typename F>
+void solveComponents(const F * B, const int ldB, F * X, const unsigned int m,
+		const unsigned int n, const unsigned int r,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		SolverStructures::OptimizationStatistics* optimizationStatistics,
+		SolverStructures::SolverWorkspace<F>* workspace = NULL) {
+	SolverStructures::SolverWorkspace<F> localWorkspace;
+	if (workspace == NULL)
+		workspace = &localWorkspace;
+	SparseDeflationCollection<F> deflation;
+	optimizationStatistics->componentValues.resize(r);
+	unsigned int total_iterations = 0;
+	double total_time = 0;
+	const bool sameData = workspace->sameData;
+	for (unsigned int c = 0; c < r; c++) {
+		optimizationStatistics->componentValues[c] = denseDataSolver(B, ldB,
+				&X[(size_t) n * c], m, n, optimizationSettings,
+				optimizationStatistics, workspace, &deflation);
+		total_iterations += optimizationStatistics->it;
+		total_time += optimizationStatistics->totalTrueComputationTime;
+		deflation.addNewSparsePV(&X[(size_t) n * c], n);
+		workspace->sameData = true;
+	}
+	workspace->sameData = sameData;
+	optimizationStatistics->it = total_iterations;
+	optimizationStatistics->totalTrueComputationTime = total_time;
+}
 }
 }
 
@@ -16,12 +16,16 @@
 #define SPARSE_PCA_SOLVER_CSC_H_
 #include "../class/optimization_settings.h"
 #include "../class/optimization_statistics.h"
+#include "../class/solver_workspace.h"
 #include "../utils/my_cblas_wrapper.h"
 #include "my_sparse_cblas_wrapper.h"
+#include "../utils/matrix_conversions.h"
 #include "../utils/thresh_functions.h"
 #include "../utils/timer.h"
 
 #include "sparse_PCA_thresholding.h"
+#include "gpower_commons.h"
+#include "deflation.h"
 
 #include <gsl/gsl_rng.h>
 #include <gsl/gsl_randist.h>
@@ -53,458 +57,504 @@ void printDescriptions(F* x, int length, const char* description,
 
 namespace SPCASolver {
 
+/*
+ * generates starting point number "point" into column of V (constrained or
+ * data driven strategy) or Z (random points of penalized formulations)
+ */
 template<typename F>
-class SparseDeflation {
-public:
-	std::vector<int> idx;
-	std::vector<F> vals;
-};
+void getSingleSparseStartingPoint(F* V, F* Z,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		const unsigned int n, const unsigned int m, const unsigned int point,
+		const StartingPointHeuristics<F>* heuristics = NULL) {
+	if (heuristics != NULL
+			&& optimizationSettings->startingPointStrategy
+					!= SolverStructures::RandomStartingPoints) {
+		cblas_vector_scale(n, V, (F) 0);
+		heuristics->generate(V, optimizationSettings, point);
+	} else if (optimizationSettings->isConstrainedProblem()) {
+		counter_rng_fill_uniform(V, n, (F) 0, (F) 1, optimizationSettings->seed,
+				point);
+		cblas_vector_scale(n, V, 1 / cblas_l2_norm(n, V, 1));
+	} else {
+		counter_rng_fill_uniform(Z, m, (F) -1, (F) 1,
+				optimizationSettings->seed, point);
+	}
+}
 
+/*
+ * Data dependent part of starting point heuristics (see starting_points.h) for
+ * B - 1*means' - rowMeans*1'. Squared column norms are
+ * \|b_j\|^2 - 2 c_j 1'b_j - 2 r'b_j + m c_j^2 + 2 c_j 1'r + r'r.
+ */
 template<typename F>
-class SparseDeflationCollection {
-public:
-	std::vector<SparseDeflation<F> > list;
-	std::vector<F> buffer;
-
-	void deflateVByPV(F* V, int n, int experiments, SparseDeflation<F> & pv) {
-		// V = (I - xx') V
-		F zero = 0.0;
-		buffer.resize(experiments);
-		cblas_vector_scale(experiments, &buffer[0], zero);
-		for (int ex = 0; ex < experiments; ex++) {
-			for (int cor = 0; cor < pv.idx.size(); cor++) {
-				buffer[ex] += V[pv.idx[cor] + n * ex] * pv.vals[cor];
-			}
-		}
-
-		for (int ex = 0; ex < experiments; ex++) {
-			for (int cor = 0; cor < pv.idx.size(); cor++) {
-				V[pv.idx[cor] + n * ex] -= buffer[ex] * pv.vals[cor];
+void prepare_CSC_starting_points(StartingPointHeuristics<F>& heuristics,
+		const int m, const int n, const F * B_CSC_Vals,
+		const int* B_CSC_Row_Id, const int* B_CSC_Col_Ptr, const F* csrVals,
+		const int* csrColId, const int* csrRowPtr, const F* columnMeans,
+		const F* rowMeans,
+		const SolverStructures::OptimizationSettings* optimizationSettings) {
+	if (StartingPointHeuristics<F>::usesColumnNorms(optimizationSettings)) {
+		F rowMeansSum = 0;
+		F rowMeansSquares = 0;
+		if (rowMeans != NULL) {
+			for (int row = 0; row < m; row++) {
+				rowMeansSum += rowMeans[row];
+				rowMeansSquares += rowMeans[row] * rowMeans[row];
 			}
 		}
-
-	}
-
-	void deflateV(F* V, int n, int experiments) {
-		for (int pv = 0; pv < list.size(); pv++) {
-			this->deflateVByPV(V, n, experiments, list[pv]);
-		}
-	}
-
-	void addNewSparsePV(std::vector<F> &x) {
-		SparseDeflation<F> sparseDeflation;
-		sparseDeflation.idx.resize(0);
-		sparseDeflation.vals.resize(0);
-		for (int i = 0; i < x.size(); i++) {
-			if (x[i] != 0) {
-				sparseDeflation.vals.push_back(x[i]);
-				sparseDeflation.idx.push_back(i);
+		std::vector<F> columnNorms(n);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+		for (int col = 0; col < n; col++) {
+			const F mean = (columnMeans == NULL) ? 0 : columnMeans[col];
+			F squares = 0;
+			F sum = 0;
+			F rowDot = 0;
+			for (int i = B_CSC_Col_Ptr[col]; i < B_CSC_Col_Ptr[col + 1]; i++) {
+				const F value = B_CSC_Vals[i];
+				squares += value * value;
+				sum += value;
+				if (rowMeans != NULL)
+					rowDot += value * rowMeans[B_CSC_Row_Id[i]];
 			}
+			columnNorms[col] = squares - 2 * mean * sum - 2 * rowDot
+					+ m * mean * mean + 2 * mean * rowMeansSum + rowMeansSquares;
 		}
-		list.push_back(sparseDeflation);
+		heuristics.setColumnNorms(columnNorms, optimizationSettings);
+	} else if (StartingPointHeuristics<F>::usesSketch(optimizationSettings)) {
+		std::vector<F> omega;
+		heuristics.getOmega(omega, n, optimizationSettings);
+		const unsigned int s = heuristics.sketchSize;
+		std::vector<F> Y((size_t) m * s);
+		heuristics.sketch.resize((size_t) n * s);
+		sparse_matrix_dense_block_multiply(m, n, s, B_CSC_Vals, B_CSC_Row_Id,
+				B_CSC_Col_Ptr, csrVals, csrColId, csrRowPtr, columnMeans,
+				rowMeans, &omega[0], &Y[0]);
+		sparse_matrix_transposed_dense_block_multiply(m, n, s, B_CSC_Vals,
+				B_CSC_Row_Id, B_CSC_Col_Ptr, columnMeans, rowMeans, &Y[0],
+				&heuristics.sketch[0]);
 	}
-};
+}
 
 /*
- * Matrix B is stored in column order (Fortran Based)
+ * one iteration of all "experiments" columns; sets vals[j].val and vals[j].current_error
+ * Previous components are projected out as B (I - QQ'), V itself stays sparse.
  */
-template<typename F>
-F sparse_PCA_solver_CSC(F * B_CSC_Vals, int* B_CSC_Row_Id, int* B_CSC_Col_Ptr,
-		F * x, int m, int n,
+template<SolverStructures::SPCA_Formulation formulation, typename F>
+void perform_one_iteration_for_CSC(F* V, F* Z,
 		SolverStructures::OptimizationSettings* optimizationSettings,
 		SolverStructures::OptimizationStatistics* optimizationStatistics,
-		bool doMean, F * means, bool doRowMean, F * rowMeans,
-		SPCASolver::SparseDeflationCollection<F>& sparseDeflationCollection) {
-	int number_of_experiments = optimizationSettings->totalStartingPoints;
+		const unsigned int number_of_experiments, const int n, const int m,
+		const F * B_CSC_Vals, const int* B_CSC_Row_Id,
+		const int* B_CSC_Col_Ptr, const F* csrVals, const int* csrColId,
+		const int* csrRowPtr, const F* columnMeans, const F* rowMeans,
+		SPCASolver::SparseDeflationCollection<F>& sparseDeflationCollection,
+		F* max_errors, ValueCoordinateHolder<F>* vals, std::vector<F>* buffer,
+		const unsigned int it) {
+	// passes over columns of Z (see execution_policy.h)
+	const SolverStructures::ExecutionPolicy& policy =
+			optimizationSettings->executionPolicy;
+	const unsigned int threads = policy.threadsWithinVector(m);
+	if (SolverStructures::FormulationTraits<formulation>::constrained) {
+		sparse_matrix_dense_block_multiply(m, n, number_of_experiments,
+				B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, csrVals, csrColId,
+				csrRowPtr, columnMeans, rowMeans, V, Z); // Z = B*V
+		sparseDeflationCollection.deflateZ(Z, V, m, n, number_of_experiments);
+
+		//set Z=sgn(Z)
+		if (!SolverStructures::FormulationTraits<formulation>::L2Problem) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(policy.threadsAcrossColumns())
+#endif
+			for (unsigned int j = 0; j < number_of_experiments; j++) {
+				vals[j].tmp = vector_l1_norm_and_sgn(&Z[m * j], m, threads); //y=sgn(y)
+			}
+		}
 
-	std::vector<ValueCoordinateHolder<F> > valsVec(number_of_experiments);
-	ValueCoordinateHolder<F>* vals = &valsVec[0];
+		sparse_matrix_transposed_dense_block_multiply(m, n,
+				number_of_experiments, B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr,
+				columnMeans, rowMeans, Z, V); // V = B'*Z
 
-	std::vector<F> Zvec(m * number_of_experiments);
-	F* Z = &Zvec[0];
-	std::vector<F> Vvec(n * number_of_experiments);
-	F* V = &Vvec[0];
-	std::vector<F> ZZvec(m * number_of_experiments);
-	F* ZZ = &ZZvec[0];
-	std::vector<F> VVvec(n * number_of_experiments);
-	F* VV = &VVvec[0];
+		sparseDeflationCollection.deflateV(V, n, number_of_experiments);
 
-	optimizationStatistics->it = optimizationSettings->maximumIterations;
-	// Allocate vector for optimizationStatistics to return which point needs how much iterations
-	if (optimizationSettings->storeIterationsForAllPoints) {
-		optimizationStatistics->iters.resize(
-				optimizationSettings->totalStartingPoints, -1);
-	}
-	F FLOATING_ZERO = 0;
-	if (optimizationSettings->isConstrainedProblem()) {
-		//				cblas_dscal(n * number_of_experiments, 0, V, 1);
 #ifdef _OPENMP
-//#pragma omp parallel for
+#pragma omp parallel for num_threads(policy.threadsAcrossColumns())
 #endif
 		for (unsigned int j = 0; j < number_of_experiments; j++) {
-			myseed = rand();
-			F tmp_norm = 0;
-			//			for (unsigned int i = 0; i < n;i++){//optimizationSettings->constraintParameter; i++) {
-			//				unsigned int idx = i;
-
-			for (unsigned int i = 0; i < n; i++) {
-				unsigned int idx = i;//(int) (n * (F) rand_r(&myseed) / (RAND_MAX));
-				if (idx == n)
-					idx--;
-				//printf("%d\n",idx);
-
-				F tmp = (F) rand_r(&myseed) / RAND_MAX;
-				V[j * n + idx] = tmp;
-				tmp_norm += tmp * tmp;
+			F fval_current = 0;
+			if (SolverStructures::FormulationTraits<formulation>::L2Problem) {
+				fval_current = vector_l2_norm(&Z[m * j], m, threads);
 			}
-			cblas_vector_scale(n, &V[j * n], 1 / sqrt(tmp_norm));
+			// x = S_w(x) / \|S_w(x)\| or x = T_k(x) / \|T_k(x)\|
+			if (SolverStructures::FormulationTraits<formulation>::L1Sparsity) {
+				soft_thresholding(&V[n * j], n,
+						optimizationSettings->constraintParameter, buffer[j],
+						optimizationSettings, true);
+			} else {
+				k_hard_thresholding(&V[n * j], n,
+						optimizationSettings->constraintParameter, buffer[j],
+						optimizationSettings, true);
+			}
+			if (!SolverStructures::FormulationTraits<formulation>::L2Problem) {
+				fval_current = vals[j].tmp;
+			}
+			F tmp_error = computeTheError(fval_current, vals[j].val,
+					optimizationSettings);
+			vals[j].current_error = tmp_error;
+			if (max_errors[my_thread_id] < tmp_error)
+				max_errors[my_thread_id] = tmp_error;
+			vals[j].val = fval_current;
 		}
-
 	} else {
+		// L2 formulations: v = B'z / \|z\| is scaled within the thresholding
+		std::vector<F> scales;
+		if (!SolverStructures::FormulationTraits<formulation>::L2Problem) {
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for num_threads(policy.threadsAcrossColumns())
 #endif
-		for (unsigned int j = 0; j < number_of_experiments; j++) {
-			myseed = j;
-			F tmp_norm = 0;
-			for (unsigned int i = 0; i < m; i++) {
-				F tmp = (F) rand_r(&myseed) / RAND_MAX;
-				tmp = -1 + 2 * tmp;
-				Z[j * m + i] = tmp;
+			for (unsigned int j = 0; j < number_of_experiments; j++) {
+				vector_l1_norm_and_sgn(&Z[m * j], m, threads);
+			}
+		} else {
+			scales.resize(number_of_experiments);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(policy.threadsAcrossColumns())
+#endif
+			for (unsigned int j = 0; j < number_of_experiments; j++) {
+				scales[j] = 1 / vector_l2_norm(&Z[m * j], m, threads);
 			}
 		}
-	}
-
-	F error = 0;
-	F max_errors[TOTAL_THREADS];
 
-	F floating_zero = 0;
-	F floating_one = 1;
-	MKL_INT ONE_MKL_INT = 1;
-	char matdescra[6];
-	matdescra[0] = 'g';
-	matdescra[1] = 'X';
-	matdescra[2] = 'X';
-	matdescra[3] = 'C';
+		//----------------------------------------------
+		sparse_matrix_transposed_dense_block_multiply(m, n,
+				number_of_experiments, B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr,
+				columnMeans, rowMeans, Z, V); // V = B'*Z
 
-	std::vector<std::vector<F> > bufferVector(number_of_experiments);
-	std::vector<F>* buffer = &bufferVector[0];
+		sparseDeflationCollection.deflateV(V, n, number_of_experiments);
+		//----------------------------------------------
 
-	if (optimizationSettings->isConstrainedProblem()) {
-		for (unsigned int j = 0; j < number_of_experiments; j++) {
-			buffer[j].resize(n);
+		const F* scalesOrNull = scales.empty() ? NULL : &scales[0];
+		if (SolverStructures::FormulationTraits<formulation>::L1Sparsity) {
+			L1_penalized_thresholding(number_of_experiments, n, V,
+					optimizationSettings, max_errors, vals,
+					optimizationStatistics, it, 0, NULL, scalesOrNull);
+		} else {
+			L0_penalized_thresholding(number_of_experiments, n, V,
+					optimizationSettings, max_errors, vals,
+					optimizationStatistics, it, 0, NULL, scalesOrNull);
 		}
+//----------------------------------------
+		sparse_matrix_dense_block_multiply(m, n, number_of_experiments,
+				B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, csrVals, csrColId,
+				csrRowPtr, columnMeans, rowMeans, V, Z); // Z = B*V
+		sparseDeflationCollection.deflateZ(Z, V, m, n, number_of_experiments);
+		//-------------------------------------
 	}
+}
 
-	double start_time_of_iterations = gettime();
-	for (unsigned int it = 0; it < optimizationSettings->maximumIterations;
-			it++) {
-		for (unsigned int tmp = 0; tmp < TOTAL_THREADS; tmp++) {
-			max_errors[tmp] = 0;
-		}
-		if (optimizationSettings->isConstrainedProblem()) {
-
-			sparseDeflationCollection.deflateV(V, n, number_of_experiments);
-
-			for (int ex = 0; ex < number_of_experiments; ex++) {
-				for (int i = 0; i < n; i++)
-					VV[i * number_of_experiments + ex] = V[i + ex * n];
-			}
-			sparse_matrix_matrix_multiply(MY_SPARSE_WRAPPER_NOTRANS, m,
-					number_of_experiments, n, &floating_one, matdescra,
-					B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, &B_CSC_Col_Ptr[1],
-					VV, number_of_experiments, &floating_zero, ZZ,
-					number_of_experiments);
-			for (int ex = 0; ex < number_of_experiments; ex++) {
-				for (int i = 0; i < m; i++)
-					Z[i + m * ex] = ZZ[number_of_experiments * i + ex];
-			}
-
-			if (doMean) {
-//				we have done   Z = B*V, now and we would like to have
-//				Z = (B - E*diag(means) ) * V
-				for (int ex = 0; ex < number_of_experiments; ex++) {
-					F tmpVal = 0;
-					for (int kk = 0; kk < n; kk++) {
-						tmpVal += means[kk] * V[kk + n * ex];
-					}
-					for (int i = 0; i < m; i++) {
-						Z[i + m * ex] -= tmpVal;
-					}
-				}
-			}
-			if (doRowMean) {
-				//				we have done   Z = B*V, now and we would like to have
-				//				Z = (B - diag(rowMeans) *E ) * V
-				for (int ex = 0; ex < number_of_experiments; ex++) {
-					F tmpVal = 0;
-					for (int kk = 0; kk < n; kk++) {
-						tmpVal += V[kk + n * ex];
-					}
-					for (int i = 0; i < m; i++) {
-						Z[i + m * ex] -= tmpVal * rowMeans[i];
-					}
-				}
-			}
-
-			//set Z=sgn(Z)
-			if (optimizationSettings->formulation
-					== SolverStructures::L0_constrained_L1_PCA
-					|| optimizationSettings->formulation
-							== SolverStructures::L1_constrained_L1_PCA) {
+/*
+ * Matrix B is stored in CSC format
+ *
+ * Starting points are processed in slots of "batchSize" columns of V and Z,
+ * so memory does not depend on totalStartingPoints. A point is retired as
+ * soon as it converges (or reaches maximumIterations); with useOTF its slot
+ * is immediately refilled with a new starting point, otherwise the next
+ * batch starts when all points of the current one are retired. Live slots
+ * are kept at the front, so the sparse products shrink once no new points
+ * are available.
+ *
+ * If workspace is given, its memory is used (and grown if needed) instead of
+ * allocating new one, so it can be reused by consecutive calls. The CSR copy
+ * of B it holds is reused only if workspace->sameData is set (see
+ * SolverWorkspace) and B has the same pointer, dimensions and nnz.
+ *
+ * A constrained problem with cardinality 0 is rejected, -1 is returned.
+ *
+ * Instantiated for optimizationSettings->formulation, see
+ * sparse_PCA_solver_CSC.
+ */
+template<SolverStructures::SPCA_Formulation formulation, typename F>
+F formulation_sparse_PCA_solver_CSC(F * B_CSC_Vals, int* B_CSC_Row_Id,
+		int* B_CSC_Col_Ptr, F * x, int m, int n,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		SolverStructures::OptimizationStatistics* optimizationStatistics,
+		bool doMean, F * means, bool doRowMean, F * rowMeans,
+		SPCASolver::SparseDeflationCollection<F>& sparseDeflationCollection,
+		SolverStructures::SolverWorkspace<F>* workspace) {
+	if (!optimizationSettings->chceckInputAndModifyIt(n)) {
+		optimizationStatistics->it = 0;
+		optimizationStatistics->fval = -1;
+		return -1;
+	}
+	const unsigned int number_of_experiments_per_batch =
+			optimizationSettings->batchSize;
+	const unsigned int totalStartingPoints =
+			optimizationSettings->totalStartingPoints;
+
+	SolverStructures::SolverWorkspace<F> localWorkspace;
+	if (workspace == NULL)
+		workspace = &localWorkspace;
+	workspace->prepare(m, n, number_of_experiments_per_batch,
+			SolverStructures::FormulationTraits<formulation>::constrained);
+	ValueCoordinateHolder<F>* vals = &workspace->vals[0];
+	F* Z = workspace->Z.data;
+	F* V = workspace->V.data;
+	std::vector<F>* buffer = workspace->getBuffers();
+
+	// rank-one corrections are fused into the sparse products
+	const F* columnMeans = doMean ? means : NULL;
+	const F* rowMeansOrNull = doRowMean ? rowMeans : NULL;
+
+	// with less experiments than threads B*V is parallelized over rows of B,
+	// which needs CSR copy of B (kept in workspace for next calls with the same B)
+	const F* csrVals = NULL;
+	const int* csrColId = NULL;
+	const int* csrRowPtr = NULL;
+	int maxThreads = 1;
 #ifdef _OPENMP
-#pragma omp parallel for
+	maxThreads = omp_get_max_threads();
 #endif
-				for (unsigned int j = 0; j < number_of_experiments; j++) {
-					vals[j].tmp = cblas_l1_norm(m, &Z[m * j], 1);
-					vector_sgn(&Z[m * j], m);			//y=sgn(y)
-				}
-			}
-
-			for (int ex = 0; ex < number_of_experiments; ex++) {
-				for (int i = 0; i < m; i++)
-					ZZ[number_of_experiments * i + ex] = Z[i + m * ex];
-			}
-			sparse_matrix_matrix_multiply(MY_SPARSE_WRAPPER_TRANS, m,
-					number_of_experiments, n, &floating_one, matdescra,
-					B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, &B_CSC_Col_Ptr[1],
-					ZZ, number_of_experiments, &floating_zero, VV,
-					number_of_experiments);
-			for (int ex = 0; ex < number_of_experiments; ex++) {
-				for (int i = 0; i < n; i++)
-					V[i + ex * n] = VV[i * number_of_experiments + ex];
-			}
-			if (doMean) {
-//				we have done   Z = B*V, now and we would like to have
-//				V = (B - E*diag(means) )' * Z
-//				V = B'Z - diag(means) E' * Z
-				for (int ex = 0; ex < number_of_experiments; ex++) {
-					F tmpVal = 0;
-					for (int i = 0; i < m; i++) {
-						tmpVal += Z[i + m * ex];
-					}
-					for (int kk = 0; kk < n; kk++) {
-						V[kk + n * ex] -= means[kk] * tmpVal;
-					}
+	SolverStructures::set_blas_threads(maxThreads);
+	if (!workspace->sameData)
+		workspace->invalidate();
+	if ((int) number_of_experiments_per_batch < maxThreads) {
+		if (workspace->csrSource != B_CSC_Vals || workspace->csrM != m
+				|| workspace->csrN != n
+				|| workspace->csrNnz != B_CSC_Col_Ptr[n]) {
+			getCSR_from_CSC(B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr,
+					workspace->csrVals, workspace->csrColId,
+					workspace->csrRowPtr, m, n);
+			workspace->csrSource = B_CSC_Vals;
+			workspace->csrM = m;
+			workspace->csrN = n;
+			workspace->csrNnz = B_CSC_Col_Ptr[n];
+		}
+		csrVals = &workspace->csrVals[0];
+		csrColId = &workspace->csrColId[0];
+		csrRowPtr = &workspace->csrRowPtr[0];
+	}
 
-//			     for (int kk = 0; kk < n; kk++) {
-//					for (int i = 0; i < m; i++) {
-//							V[kk + n * ex] -= means[kk] * Z[i + m * ex];
-//						}
-//					}
-				}
-			}
-			if (doRowMean) {
-				//				we have done   Z = B*V, now and we would like to have
-				//				V = (B - diag(rowMeans) E* )' * Z
-				for (int ex = 0; ex < number_of_experiments; ex++) {
-					F tmpVal = 0;
-					for (int i = 0; i < m; i++) {
-						tmpVal += Z[i + m * ex] * rowMeans[i];
-					}
-					for (int kk = 0; kk < n; kk++) {
-						V[kk + n * ex] -= tmpVal;
-					}
-				}
-			}
+	// image of previous components, B*Q
+	if (!sparseDeflationCollection.empty()) {
+		std::vector<F> Q((size_t) n * sparseDeflationCollection.components);
+		sparseDeflationCollection.getDenseComponents(&Q[0], n);
+		sparseDeflationCollection.BQ.resize(
+				(size_t) m * sparseDeflationCollection.components);
+		sparse_matrix_dense_block_multiply(m, n,
+				sparseDeflationCollection.components, B_CSC_Vals,
+				B_CSC_Row_Id, B_CSC_Col_Ptr, csrVals, csrColId, csrRowPtr,
+				columnMeans, rowMeansOrNull, &Q[0],
+				&sparseDeflationCollection.BQ[0]);
+	}
 
-			sparseDeflationCollection.deflateV(V, n, number_of_experiments);
+	// Allocate vector for optimizationStatistics to return which point needs how much iterations
+	const bool storeIterationsForAllPoints =
+			optimizationSettings->storeIterationsForAllPoints;
+	if (storeIterationsForAllPoints) {
+		optimizationStatistics->iters.resize(totalStartingPoints);
+		optimizationStatistics->cardinalities.resize(totalStartingPoints);
+		std::fill(optimizationStatistics->iters.begin(),
+				optimizationStatistics->iters.end(), -1);
+		std::fill(optimizationStatistics->cardinalities.begin(),
+				optimizationStatistics->cardinalities.end(), -1);
+	}
+	optimizationStatistics->values.resize(totalStartingPoints);
+	// slots do not correspond to points, iterations are logged on retirement
+	optimizationSettings->storeIterationsForAllPoints = false;
 
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-			for (unsigned int j = 0; j < number_of_experiments; j++) {
-				F fval_current = 0;
-				if (optimizationSettings->formulation
-						== SolverStructures::L0_constrained_L2_PCA
-						|| optimizationSettings->formulation
-								== SolverStructures::L1_constrained_L2_PCA) {
-					fval_current = cblas_l2_norm(m, &Z[m * j], 1);
-				}
-				F norm_of_x;
-				if (optimizationSettings->isL1ConstrainedProblem()) {
-					norm_of_x = soft_thresholding(&V[n * j], n,
-							optimizationSettings->constraintParameter,
-							buffer[j], optimizationSettings); // x = S_w(x)
-				} else {
-					norm_of_x = k_hard_thresholding(&V[n * j], n,
-							optimizationSettings->constraintParameter,
-							buffer[j], optimizationSettings); // x = T_k(x)
-				}
+	F max_errors[TOTAL_THREADS];
+	F the_best_solution_value = -1;
+	unsigned int total_iterations = 0;
+	std::vector<unsigned int> slot_point(number_of_experiments_per_batch);
+	std::vector<unsigned int> slot_iteration(number_of_experiments_per_batch);
+	unsigned int generated_points = 0;
+	unsigned int live = 0;
 
-				cblas_vector_scale(n, &V[j * n], 1 / norm_of_x);
-				if (optimizationSettings->formulation
-						== SolverStructures::L0_constrained_L1_PCA
-						|| optimizationSettings->formulation
-								== SolverStructures::L1_constrained_L1_PCA) {
-					fval_current = vals[j].tmp;
-				}
-				F tmp_error = computeTheError(fval_current, vals[j].val,
-						optimizationSettings);
-				//Log end of iteration for given point
-				if (optimizationSettings->storeIterationsForAllPoints
-						&& termination_criteria(tmp_error, it,
-								optimizationSettings)
-						&& optimizationStatistics->iters[j] == -1) {
-					optimizationStatistics->iters[j] = it;
-				} else if (optimizationSettings->storeIterationsForAllPoints
-						&& !termination_criteria(tmp_error, it,
-								optimizationSettings)
-						&& optimizationStatistics->iters[j] != -1) {
-					optimizationStatistics->iters[j] = -1;
-				}
-				//---------------
-				if (max_errors[my_thread_id] < tmp_error)
-					max_errors[my_thread_id] = tmp_error;
-				vals[j].val = fval_current;
+	double start_time_of_iterations = gettime();
+	StartingPointHeuristics<F> heuristics;
+	prepare_CSC_starting_points(heuristics, m, n, B_CSC_Vals, B_CSC_Row_Id,
+			B_CSC_Col_Ptr, csrVals, csrColId, csrRowPtr, columnMeans,
+			rowMeansOrNull, optimizationSettings);
+	// data driven points of penalized formulations are generated into V
+	const bool penalizedFromV =
+			!SolverStructures::FormulationTraits<formulation>::constrained
+			&& optimizationSettings->startingPointStrategy
+					!= SolverStructures::RandomStartingPoints;
+	while (true) {
+		if (optimizationSettings->useOTF || live == 0) {
+			// fill free slots with new starting points
+			const unsigned int first_new = live;
+			while (live < number_of_experiments_per_batch
+					&& generated_points < totalStartingPoints) {
+				slot_point[live] = generated_points;
+				slot_iteration[live] = 0;
+				vals[live].reset();
+				generated_points++;
+				live++;
 			}
-		} else {
-			//scale Z
-
-			if (optimizationSettings->formulation
-					== SolverStructures::L0_penalized_L1_PCA
-					|| optimizationSettings->formulation
-							== SolverStructures::L1_penalized_L1_PCA) {
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-				for (unsigned int j = 0; j < number_of_experiments; j++) {
-					vector_sgn(&Z[m * j], m);
-				}
-			} else {
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-				for (unsigned int j = 0; j < number_of_experiments; j++) {
-					F tmp_norm = cblas_l2_norm(m, &Z[m * j], 1);
-					cblas_vector_scale(m, &Z[j * m], 1 / tmp_norm);
-				}
-			}
-
-			//----------------------------------------------
-			for (int ex = 0; ex < number_of_experiments; ex++) {
-				for (int i = 0; i < m; i++)
-					ZZ[number_of_experiments * i + ex] = Z[i + m * ex];
+			for (unsigned int j = first_new; j < live; j++) {
+				getSingleSparseStartingPoint(&V[j * n], &Z[j * m],
+						optimizationSettings, n, m, slot_point[j], &heuristics);
 			}
-			sparse_matrix_matrix_multiply(MY_SPARSE_WRAPPER_TRANS, m,
-					number_of_experiments, n, &floating_one, matdescra,
-					B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, &B_CSC_Col_Ptr[1],
-					ZZ, number_of_experiments, &floating_zero, VV,
-					number_of_experiments);
-			for (int ex = 0; ex < number_of_experiments; ex++) {
-				for (int i = 0; i < n; i++)
-					V[i + ex * n] = VV[i * number_of_experiments + ex];
+			if (penalizedFromV && live > first_new) {
+				sparse_matrix_dense_block_multiply(m, n, live - first_new,
+						B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, csrVals,
+						csrColId, csrRowPtr, columnMeans, rowMeansOrNull,
+						&V[first_new * n], &Z[first_new * m]); // Z = B*V
+				sparseDeflationCollection.deflateZ(&Z[first_new * m],
+						&V[first_new * n], m, n, live - first_new);
 			}
-
-			if (doMean) {
-				//				we have done   Z = B*V, now and we would like to have
-				//				V = (B - E*diag(means) )' * Z
-				//				V = B'Z - diag(means) E' * Z
-				for (int ex = 0; ex < number_of_experiments; ex++) {
-					for (int kk = 0; kk < n; kk++) {
-						for (int i = 0; i < m; i++) {
-							V[kk + n * ex] -= means[kk] * Z[i + m * ex];
-						}
-					}
-				}
-			}
-			if (doRowMean) {
-				//				we have done   Z = B*V, now and we would like to have
-				//				V = (B - diag(rowMeans) E* )' * Z
-				for (int ex = 0; ex < number_of_experiments; ex++) {
-					F tmpVal = 0;
-					for (int i = 0; i < m; i++) {
-						tmpVal += Z[i + m * ex] * rowMeans[i];
-					}
-					for (int kk = 0; kk < n; kk++) {
-						V[kk + n * ex] -= tmpVal;
-					}
-				}
-			}
-
-			sparseDeflationCollection.deflateV(V, n, number_of_experiments);
-			//----------------------------------------------
-
-			if (optimizationSettings->isL1PenalizedProblem()) {
-				L1_penalized_thresholding(number_of_experiments, n, V,
-						optimizationSettings, max_errors, vals,
-						optimizationStatistics, it);
+		}
+		if (live == 0)
+			break;
+		total_iterations++;
+		for (unsigned int tmp = 0; tmp < TOTAL_THREADS; tmp++) {
+			max_errors[tmp] = 0;
+		}
+		optimizationSettings->executionPolicy.decide(
+				optimizationSettings->threadingMode, live, m, n,
+				SolverStructures::FormulationTraits<formulation>::constrained);
+		// "it" is used only for logging, which is done on retirement here
+		perform_one_iteration_for_CSC<formulation>(V, Z, optimizationSettings,
+				optimizationStatistics, live, n, m, B_CSC_Vals, B_CSC_Row_Id,
+				B_CSC_Col_Ptr, csrVals, csrColId, csrRowPtr, columnMeans,
+				rowMeansOrNull, sparseDeflationCollection, max_errors, vals,
+				buffer, total_iterations - 1);
+		unsigned int kept = 0;
+		for (unsigned int i = 0; i < live; i++) {
+			const unsigned int it = slot_iteration[i];
+			const bool converged = termination_criteria(vals[i].current_error,
+					it, optimizationSettings);
+			if (converged || it + 1 >= (unsigned int)
+					optimizationSettings->maximumIterations) {
+				retire_starting_point(&V[n * i], vals[i].val, x,
+						the_best_solution_value, n, converged ? (int) it : -1,
+						storeIterationsForAllPoints, optimizationStatistics,
+						slot_point[i]);
 			} else {
-				L0_penalized_thresholding(number_of_experiments, n, V,
-						optimizationSettings, max_errors, vals,
-						optimizationStatistics, it);
-			}
-//----------------------------------------
-			sparseDeflationCollection.deflateV(V, n, number_of_experiments);
-			for (int ex = 0; ex < number_of_experiments; ex++) {
-				for (int i = 0; i < n; i++)
-					VV[i * number_of_experiments + ex] = V[i + ex * n];
-			}
-			sparse_matrix_matrix_multiply(MY_SPARSE_WRAPPER_NOTRANS, m,
-					number_of_experiments, n, &floating_one, matdescra,
-					B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, &B_CSC_Col_Ptr[1],
-					VV, number_of_experiments, &floating_zero, ZZ,
-					number_of_experiments);
-			for (int ex = 0; ex < number_of_experiments; ex++) {
-				for (int i = 0; i < m; i++)
-					Z[i + m * ex] = ZZ[number_of_experiments * i + ex];
-			}
-			if (doMean) {
-				//				we have done   Z = B*V, now and we would like to have
-				//				Z = (B - E*diag(means) ) * V
-				for (int ex = 0; ex < number_of_experiments; ex++) {
-					for (int i = 0; i < m; i++) {
-						for (int kk = 0; kk < n; kk++) {
-							Z[i + m * ex] -= means[kk] * V[kk + n * ex];
-						}
-					}
+				if (kept != i) {
+					cblas_vector_copy(n, &V[n * i], 1, &V[n * kept], 1);
+					cblas_vector_copy(m, &Z[m * i], 1, &Z[m * kept], 1);
+					vals[kept] = vals[i];
+					slot_point[kept] = slot_point[i];
 				}
+				slot_iteration[kept] = it + 1;
+				kept++;
 			}
-			if (doRowMean) {
-				//				we have done   Z = B*V, now and we would like to have
-				//				Z = (B - diag(rowMeans) *E ) * V
-				for (int ex = 0; ex < number_of_experiments; ex++) {
-					F tmpVal = 0;
-					for (int kk = 0; kk < n; kk++) {
-						tmpVal += V[kk + n * ex];
-					}
-					for (int i = 0; i < m; i++) {
-						Z[i + m * ex] -= tmpVal * rowMeans[i];
-					}
-				}
-			}
-			//-------------------------------------
 		}
-		error =
-				max_errors[cblas_vector_max_index(TOTAL_THREADS, max_errors, 1)];
-		if (termination_criteria(error, it, optimizationSettings)) {
-			optimizationStatistics->it = it;
-			break;
-		}
-
+		live = kept;
 	}
 	double end_time_of_iterations = gettime();
-//compute corresponding x
-	optimizationStatistics->values.resize(
-			optimizationSettings->totalStartingPoints);
-	int selected_idx = 0;
-	F best_value = vals[selected_idx].val;
-	optimizationStatistics->values[0] = best_value;
+	optimizationSettings->executionPolicy = SolverStructures::ExecutionPolicy();
+	optimizationSettings->storeIterationsForAllPoints =
+			storeIterationsForAllPoints;
+	optimizationStatistics->it = total_iterations;
 	optimizationStatistics->totalTrueComputationTime = (end_time_of_iterations
 			- start_time_of_iterations);
-	for (unsigned int i = 1; i < number_of_experiments; i++) {
-		optimizationStatistics->values[i] = vals[i].val;
-		if (vals[i].val > best_value) {
-			best_value = vals[i].val;
-			selected_idx = i;
-		}
-	}
-	cblas_vector_copy(n, &V[n * selected_idx], 1, x, 1);
+	//compute corresponding x
 	F norm_of_x = cblas_l2_norm(n, x, 1);
 	cblas_vector_scale(n, x, 1 / norm_of_x); //Final x
 
-	optimizationStatistics->fval = best_value;
-	return best_value;
+	optimizationStatistics->fval = the_best_solution_value;
+	return the_best_solution_value;
+}
+
+// the only test of the formulation at run time (see dense_solver)
+template<typename F>
+F sparse_PCA_solver_CSC(F * B_CSC_Vals, int* B_CSC_Row_Id, int* B_CSC_Col_Ptr,
+		F * x, int m, int n,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		SolverStructures::OptimizationStatistics* optimizationStatistics,
+		bool doMean, F * means, bool doRowMean, F * rowMeans,
+		SPCASolver::SparseDeflationCollection<F>& sparseDeflationCollection,
+		SolverStructures::SolverWorkspace<F>* workspace = NULL) {
+	switch (optimizationSettings->formulation) {
+	case SolverStructures::L0_constrained_L2_PCA:
+		return formulation_sparse_PCA_solver_CSC<SolverStructures::L0_constrained_L2_PCA>(
+				B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, x, m, n,
+				optimizationSettings, optimizationStatistics, doMean, means,
+				doRowMean, rowMeans, sparseDeflationCollection, workspace);
+	case SolverStructures::L0_constrained_L1_PCA:
+		return formulation_sparse_PCA_solver_CSC<SolverStructures::L0_constrained_L1_PCA>(
+				B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, x, m, n,
+				optimizationSettings, optimizationStatistics, doMean, means,
+				doRowMean, rowMeans, sparseDeflationCollection, workspace);
+	case SolverStructures::L1_constrained_L2_PCA:
+		return formulation_sparse_PCA_solver_CSC<SolverStructures::L1_constrained_L2_PCA>(
+				B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, x, m, n,
+				optimizationSettings, optimizationStatistics, doMean, means,
+				doRowMean, rowMeans, sparseDeflationCollection, workspace);
+	case SolverStructures::L1_constrained_L1_PCA:
+		return formulation_sparse_PCA_solver_CSC<SolverStructures::L1_constrained_L1_PCA>(
+				B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, x, m, n,
+				optimizationSettings, optimizationStatistics, doMean, means,
+				doRowMean, rowMeans, sparseDeflationCollection, workspace);
+	case SolverStructures::L0_penalized_L2_PCA:
+		return formulation_sparse_PCA_solver_CSC<SolverStructures::L0_penalized_L2_PCA>(
+				B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, x, m, n,
+				optimizationSettings, optimizationStatistics, doMean, means,
+				doRowMean, rowMeans, sparseDeflationCollection, workspace);
+	case SolverStructures::L0_penalized_L1_PCA:
+		return formulation_sparse_PCA_solver_CSC<SolverStructures::L0_penalized_L1_PCA>(
+				B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, x, m, n,
+				optimizationSettings, optimizationStatistics, doMean, means,
+				doRowMean, rowMeans, sparseDeflationCollection, workspace);
+	case SolverStructures::L1_penalized_L2_PCA:
+		return formulation_sparse_PCA_solver_CSC<SolverStructures::L1_penalized_L2_PCA>(
+				B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, x, m, n,
+				optimizationSettings, optimizationStatistics, doMean, means,
+				doRowMean, rowMeans, sparseDeflationCollection, workspace);
+	case SolverStructures::L1_penalized_L1_PCA:
+		return formulation_sparse_PCA_solver_CSC<SolverStructures::L1_penalized_L1_PCA>(
+				B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, x, m, n,
+				optimizationSettings, optimizationStatistics, doMean, means,
+				doRowMean, rowMeans, sparseDeflationCollection, workspace);
+	}
+	return -1;
+}
+
+/*
+ * Computes r sparse components of CSC matrix B into columns of X (n x r).
+ * Component c is the solution for B (I - QQ'), where Q are the previous
+ * components orthonormalized. Workspace (and CSR copy of B) is shared by all
+ * components.
+ *
+ * optimizationStatistics describe the last component, "it" and
+ * totalTrueComputationTime are totals and componentValues holds the objective
+ * value of every component.
+ */
+template<typename F>
+void solveComponents(F * B_CSC_Vals, int* B_CSC_Row_Id, int* B_CSC_Col_Ptr,
+		F * X, int m, int n, const unsigned int r,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		SolverStructures::OptimizationStatistics* optimizationStatistics,
+		bool doMean, F * means, bool doRowMean, F * rowMeans,
+		SolverStructures::SolverWorkspace<F>* workspace = NULL) {
+	SolverStructures::SolverWorkspace<F> localWorkspace;
+	if (workspace == NULL)
+		workspace = &localWorkspace;
+	SparseDeflationCollection<F> deflation;
+	optimizationStatistics->componentValues.resize(r);
+	unsigned int total_iterations = 0;
+	double total_time = 0;
+	const bool sameData = workspace->sameData;
+	for (unsigned int c = 0; c < r; c++) {
+		optimizationStatistics->componentValues[c] = sparse_PCA_solver_CSC(
+				B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr, &X[(size_t) n * c],
+				m, n, optimizationSettings, optimizationStatistics, doMean,
+				means, doRowMean, rowMeans, deflation, workspace);
+		total_iterations += optimizationStatistics->it;
+		total_time += optimizationStatistics->totalTrueComputationTime;
+		deflation.addNewSparsePV(&X[(size_t) n * c], n);
+		workspace->sameData = true;
+	}
+	workspace->sameData = sameData;
+	optimizationStatistics->it = total_iterations;
+	optimizationStatistics->totalTrueComputationTime = total_time;
 }
 
 }
@@ -20,28 +20,118 @@
 #include "../class/optimization_statistics.h"
 #include "../class/optimization_settings.h"
 #include "../utils/various.h"
+#include <cmath>
 
+/*
+ * One read-modify-write pass over a column v (length n): v is multiplied by
+ * "scale" (1/\|z\| of L2 formulations, so the GEMM result need not be scaled
+ * separately), thresholded, and the objective and the cardinality of the
+ * result are accumulated. Written with selects only, so the loops are
+ * vectorized also for SSE2. With "threads" > 1 the column is split into
+ * chunks (see execution_policy.h).
+ */
+template<typename F>
+F L1_penalized_column(F* v, const unsigned int n, const F scale,
+		const F penaltyParameter, unsigned int& nnz,
+		const unsigned int threads = 1) {
+	F value = 0;
+	unsigned int count = 0;
+	if (threads > 1) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) reduction(+:value,count)
+#endif
+		for (unsigned int t = 0; t < threads; t++) {
+			const unsigned int begin = SolverStructures::vector_chunk(n,
+					threads, t);
+			unsigned int chunkCount;
+			value += L1_penalized_column(&v[begin],
+					SolverStructures::vector_chunk(n, threads, t + 1) - begin,
+					scale, penaltyParameter, chunkCount);
+			count += chunkCount;
+		}
+		nnz = count;
+		return value;
+	}
+#ifdef _OPENMP
+#pragma omp simd reduction(+:value,count)
+#endif
+	for (unsigned int i = 0; i < n; i++) {
+		// (|tmp| - lambda)_+ sgn(tmp) = tmp - clip(tmp, -lambda, lambda)
+		const F tmp = v[i] * scale;
+		const F upper = (tmp < penaltyParameter) ? tmp : penaltyParameter;
+		const F clipped =
+				(upper > -penaltyParameter) ? upper : -penaltyParameter;
+		const F shrunk = tmp - clipped;
+		value += shrunk * shrunk;
+		count += (shrunk != 0);
+		v[i] = shrunk;
+	}
+	nnz = count;
+	return value;
+}
+
+template<typename F>
+F L0_penalized_column(F* v, const unsigned int n, const F scale,
+		const F penaltyParameter, unsigned int& nnz,
+		const unsigned int threads = 1) {
+	F value = 0;
+	unsigned int count = 0;
+	if (threads > 1) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) reduction(+:value,count)
+#endif
+		for (unsigned int t = 0; t < threads; t++) {
+			const unsigned int begin = SolverStructures::vector_chunk(n,
+					threads, t);
+			unsigned int chunkCount;
+			value += L0_penalized_column(&v[begin],
+					SolverStructures::vector_chunk(n, threads, t + 1) - begin,
+					scale, penaltyParameter, chunkCount);
+			count += chunkCount;
+		}
+		nnz = count;
+		return value;
+	}
+#ifdef _OPENMP
+#pragma omp simd reduction(+:value,count)
+#endif
+	for (unsigned int i = 0; i < n; i++) {
+		const F tmp = v[i] * scale;
+		const F gain = tmp * tmp - penaltyParameter;
+		value += (gain > 0) ? gain : 0;
+		count += (gain > 0);
+		v[i] = (gain > 0) ? tmp : 0;
+	}
+	nnz = count;
+	return value;
+}
+
+/*
+ * If penaltyParameters is given, column j is thresholded with
+ * penaltyParameters[j] instead of optimizationSettings->penaltyParameter.
+ * If scales is given, column j is multiplied by scales[j] first (see
+ * L1_penalized_column). Columns are processed in parallel or one after
+ * another with parallel passes, see optimizationSettings->executionPolicy.
+ */
 
 template<typename F>
 void L1_penalized_thresholding(const unsigned int number_of_experiments,
 		const unsigned int n, F* V, const SolverStructures::OptimizationSettings* optimizationSettings,
 		F* max_errors, ValueCoordinateHolder<F>* vals,
-		SolverStructures::OptimizationStatistics* optimizationStatistics, const unsigned int it,unsigned int optimizationStatisticsistical_shift=0) {
+		SolverStructures::OptimizationStatistics* optimizationStatistics, const unsigned int it,unsigned int optimizationStatisticsistical_shift=0,
+		const double* penaltyParameters = NULL, const F* scales = NULL) {
+	const unsigned int threads =
+			optimizationSettings->executionPolicy.threadsWithinVector(n);
 #ifdef _OPENMP
-//#pragma omp parallel for
+#pragma omp parallel for num_threads(optimizationSettings->executionPolicy.threadsAcrossColumns())
 #endif
 	for (unsigned int j = 0; j < number_of_experiments; j++) {
-		F fval_current = 0;
-		for (unsigned i = 0; i < n; i++) {
-			F const tmp = V[n * j + i];
-			F tmp2 = abs(tmp) - optimizationSettings->penaltyParameter;
-			if (tmp2 > 0) {
-				fval_current += tmp2 * tmp2;
-				V[n * j + i] = tmp2 * sgn(tmp);
-			} else {
-				V[n * j + i] = 0;
-			}
-		}
+		const F penaltyParameter = (penaltyParameters == NULL) ?
+				optimizationSettings->penaltyParameter : penaltyParameters[j];
+		unsigned int nnz;
+		F fval_current = L1_penalized_column(&V[n * j], n,
+				(scales == NULL) ? (F) 1 : scales[j], penaltyParameter, nnz,
+				threads);
 
 
 		fval_current = sqrt(fval_current);
@@ -54,7 +144,7 @@ void L1_penalized_thresholding(const unsigned int number_of_experiments,
 		if (optimizationSettings->storeIterationsForAllPoints && termination_criteria(tmp_error,
 				it, optimizationSettings) && optimizationStatistics->iters[j+optimizationStatisticsistical_shift] == -1) {
 			optimizationStatistics->iters[j+optimizationStatisticsistical_shift] = it;
-			optimizationStatistics->cardinalities[j+optimizationStatisticsistical_shift] = vector_get_nnz(&V[j * n], n);
+			optimizationStatistics->cardinalities[j+optimizationStatisticsistical_shift] = nnz;
 		} else if (optimizationSettings->storeIterationsForAllPoints && !termination_criteria(
 				tmp_error, it, optimizationSettings) && optimizationStatistics->iters[optimizationStatisticsistical_shift+j] != -1) {
 			optimizationStatistics->iters[j+optimizationStatisticsistical_shift] = -1;
@@ -68,21 +158,20 @@ template<typename F>
 void L0_penalized_thresholding(const unsigned int number_of_experiments,
 		const unsigned int n, F* V, const SolverStructures::OptimizationSettings* optimizationSettings,
 		F* max_errors, ValueCoordinateHolder<F>* vals,
-		SolverStructures::OptimizationStatistics* optimizationStatistics, const unsigned int it,unsigned int optimizationStatisticsistical_shift=0) {
+		SolverStructures::OptimizationStatistics* optimizationStatistics, const unsigned int it,unsigned int optimizationStatisticsistical_shift=0,
+		const double* penaltyParameters = NULL, const F* scales = NULL) {
+	const unsigned int threads =
+			optimizationSettings->executionPolicy.threadsWithinVector(n);
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for num_threads(optimizationSettings->executionPolicy.threadsAcrossColumns())
 #endif
 	for (unsigned int j = 0; j < number_of_experiments; j++) {
-		F fval_current = 0;
-		for (unsigned i = 0; i < n; i++) {
-			F const tmp = V[n * j + i];
-			F tmp2 = (tmp * tmp - optimizationSettings->penaltyParameter);
-			if (tmp2 > 0) {
-				fval_current += tmp2;
-			} else {
-				V[n * j + i] = 0;
-			}
-		}
+		const F penaltyParameter = (penaltyParameters == NULL) ?
+				optimizationSettings->penaltyParameter : penaltyParameters[j];
+		unsigned int nnz;
+		F fval_current = L0_penalized_column(&V[n * j], n,
+				(scales == NULL) ? (F) 1 : scales[j], penaltyParameter, nnz,
+				threads);
 		F tmp_error = computeTheError(fval_current, vals[j].val, optimizationSettings);
 		vals[j].current_error=tmp_error;
 		if (max_errors[my_thread_id] < tmp_error)
@@ -91,7 +180,7 @@ void L0_penalized_thresholding(const unsigned int number_of_experiments,
 		//Log end of iteration for given point
 		if (optimizationSettings->storeIterationsForAllPoints && termination_criteria(tmp_error,
 				it, optimizationSettings) && optimizationStatistics->iters[j+optimizationStatisticsistical_shift] == -1) {
-			optimizationStatistics->cardinalities[optimizationStatisticsistical_shift+j] = vector_get_nnz(&V[j * n], n);
+			optimizationStatistics->cardinalities[optimizationStatisticsistical_shift+j] = nnz;
 			optimizationStatistics->iters[j+optimizationStatisticsistical_shift] = it;
 		} else if (optimizationSettings->storeIterationsForAllPoints && !termination_criteria(
 				tmp_error, it, optimizationSettings) && optimizationStatistics->iters[optimizationStatisticsistical_shift+j] != -1) {
@@ -0,0 +1,220 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  Data driven starting points (OptimizationSettings::startingPointStrategy).
+ *  Random points mostly threshold to zero for large penalty parameter (a
+ *  coordinate i survives L0 penalization only if (b_i'z)^2 > gamma), while
+ *  points built from columns of B with the largest norms, or from the leading
+ *  singular subspace of B, start where the objective is large.
+ *
+ */
+
+#ifndef STARTING_POINTS_H_
+#define STARTING_POINTS_H_
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "../class/optimization_settings.h"
+#include "../utils/counter_rng.h"
+#include "../utils/my_cblas_wrapper.h"
+#include "data_matrix.h"
+
+// number of columns of the sketch B'B*Omega
+#define STARTING_POINTS_SKETCH_SIZE 8
+// streams of the counter based generator used for Omega (points use 0, 1, ...)
+#define STARTING_POINTS_SKETCH_STREAM 0xFFFFFF00u
+
+namespace SPCASolver {
+
+template<typename F>
+class StartingPointHeuristics {
+public:
+	std::vector<unsigned int> topColumns; // "candidates" columns of B with largest norms, sorted
+	std::vector<F> sketch; // n x sketchSize, B'B*Omega
+	unsigned int sketchSize;
+	unsigned int n;
+
+	StartingPointHeuristics() {
+		sketchSize = 0;
+		n = 0;
+	}
+
+	static bool usesColumnNorms(
+			const SolverStructures::OptimizationSettings* optimizationSettings) {
+		return optimizationSettings->startingPointStrategy
+				== SolverStructures::LargestColumnsStartingPoints
+				|| optimizationSettings->startingPointStrategy
+						== SolverStructures::CombinedColumnsStartingPoints;
+	}
+
+	static bool usesSketch(
+			const SolverStructures::OptimizationSettings* optimizationSettings) {
+		return optimizationSettings->startingPointStrategy
+				== SolverStructures::SketchStartingPoints;
+	}
+
+	/*
+	 * Keeps the largest columns; columnNorms can hold norms or squared norms.
+	 * There are as many candidates as starting points (at least
+	 * constraintParameter), so with LargestColumnsStartingPoints every point
+	 * starts from a different column.
+	 */
+	void setColumnNorms(const std::vector<F>& columnNorms,
+			const SolverStructures::OptimizationSettings* optimizationSettings) {
+		n = columnNorms.size();
+		unsigned int candidates = std::max(
+				(unsigned int) optimizationSettings->totalStartingPoints,
+				optimizationSettings->constraintParameter);
+		if (candidates > n)
+			candidates = n;
+		std::vector<unsigned int> order(n);
+		for (unsigned int i = 0; i < n; i++)
+			order[i] = i;
+		std::partial_sort(order.begin(), order.begin() + candidates,
+				order.end(), NormComparator(columnNorms));
+		topColumns.assign(order.begin(), order.begin() + candidates);
+	}
+
+	/*
+	 * Omega (n x sketchSize) used to build the sketch, the caller stores
+	 * B'*(B*Omega) into "sketch"
+	 */
+	void getOmega(std::vector<F>& omega, const unsigned int n,
+			const SolverStructures::OptimizationSettings* optimizationSettings) {
+		sketchSize = std::min((unsigned int) STARTING_POINTS_SKETCH_SIZE, n);
+		this->n = n;
+		omega.resize((size_t) n * sketchSize);
+		for (unsigned int j = 0; j < sketchSize; j++)
+			counter_rng_fill_uniform(&omega[(size_t) n * j], n, (F) -1, (F) 1,
+					optimizationSettings->seed,
+					STARTING_POINTS_SKETCH_STREAM + j);
+	}
+
+	/*
+	 * Generates starting point number "point" into zero vector v (length n),
+	 * normalized. As random points, it depends only on (seed, point) and data.
+	 * Combined points mix "cardinality" columns (0 means constraintParameter).
+	 */
+	void generate(F* v,
+			const SolverStructures::OptimizationSettings* optimizationSettings,
+			const unsigned int point, unsigned int cardinality = 0) const {
+		const unsigned int seed = optimizationSettings->seed;
+		if (cardinality == 0)
+			cardinality = optimizationSettings->constraintParameter;
+		switch (optimizationSettings->startingPointStrategy) {
+		case SolverStructures::LargestColumnsStartingPoints:
+			v[topColumns[point % topColumns.size()]] = 1;
+			return;
+		case SolverStructures::CombinedColumnsStartingPoints:
+			for (unsigned int i = 0; i < cardinality; i++) {
+				unsigned int idx = (unsigned int) (topColumns.size()
+						* counter_rng_uniform<double>(seed, point, 2 * i));
+				if (idx >= topColumns.size())
+					idx = topColumns.size() - 1;
+				v[topColumns[idx]] += -1
+						+ 2 * counter_rng_uniform<F>(seed, point, 2 * i + 1);
+			}
+			break;
+		case SolverStructures::SketchStartingPoints:
+			for (unsigned int j = 0; j < sketchSize; j++)
+				cblas_vector_add(n,
+						-1 + 2 * counter_rng_uniform<F>(seed, point, j),
+						&sketch[(size_t) n * j], 1, v, 1);
+			break;
+		default:
+			return;
+		}
+		F norm = cblas_l2_norm(n, v, 1);
+		if (norm > 0)
+			cblas_vector_scale(n, v, 1 / norm);
+		else
+			v[topColumns.empty() ? 0 : topColumns[0]] = 1;
+	}
+
+private:
+	class NormComparator {
+	public:
+		const std::vector<F>& norms;
+		NormComparator(const std::vector<F>& norms) :
+				norms(norms) {
+		}
+		bool operator()(const unsigned int a, const unsigned int b) const {
+			return norms[a] > norms[b] || (norms[a] == norms[b] && a < b);
+		}
+	};
+};
+
+/*
+ * Data dependent part for dense B (column-major, leading dimension ldB, see
+ * data_matrix.h): column norms or the sketch B'B*Omega, depending on the
+ * strategy.
+ */
+template<typename F, typename Matrix>
+void prepare_dense_starting_points(StartingPointHeuristics<F>& heuristics,
+		const Matrix* B, const int ldB, const unsigned int m,
+		const unsigned int n,
+		const SolverStructures::OptimizationSettings* optimizationSettings) {
+	if (StartingPointHeuristics<F>::usesColumnNorms(optimizationSettings)) {
+		std::vector<F> columnNorms(n);
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+		{
+			std::vector<F> buffer(m);
+#ifdef _OPENMP
+#pragma omp for
+#endif
+			for (unsigned int j = 0; j < n; j++)
+				columnNorms[j] = cblas_l2_norm(m,
+						data_matrix_column(B, ldB, m, j, &buffer[0]), 1);
+		}
+		heuristics.setColumnNorms(columnNorms, optimizationSettings);
+	} else if (StartingPointHeuristics<F>::usesSketch(optimizationSettings)) {
+		std::vector<F> omega;
+		heuristics.getOmega(omega, n, optimizationSettings);
+		const unsigned int s = heuristics.sketchSize;
+		std::vector<F> Y((size_t) m * s);
+		heuristics.sketch.resize((size_t) n * s);
+		data_matrix_multiply(CblasNoTrans, m, n, s, B, ldB, &omega[0], n, &Y[0],
+				m);
+		data_matrix_multiply(CblasTrans, m, n, s, B, ldB, &Y[0], m,
+				&heuristics.sketch[0], n);
+	}
+}
+
+/*
+ * The same for Gram matrix G = B'B (n x n): column norms are sqrt(G_jj) and
+ * the sketch is G*Omega.
+ */
+template<typename F, typename Matrix>
+void prepare_gram_starting_points(StartingPointHeuristics<F>& heuristics,
+		const Matrix* G, const int ldG, const unsigned int n,
+		const SolverStructures::OptimizationSettings* optimizationSettings) {
+	if (StartingPointHeuristics<F>::usesColumnNorms(optimizationSettings)) {
+		std::vector<F> columnNorms(n);
+		std::vector<F> buffer(n);
+		for (unsigned int j = 0; j < n; j++)
+			columnNorms[j] = sqrt(
+					data_matrix_column(G, ldG, n, j, &buffer[0])[j]);
+		heuristics.setColumnNorms(columnNorms, optimizationSettings);
+	} else if (StartingPointHeuristics<F>::usesSketch(optimizationSettings)) {
+		std::vector<F> omega;
+		heuristics.getOmega(omega, n, optimizationSettings);
+		heuristics.sketch.resize((size_t) n * heuristics.sketchSize);
+		data_matrix_multiply(CblasNoTrans, n, n, heuristics.sketchSize, G, ldG,
+				&omega[0], n, &heuristics.sketch[0], n);
+	}
+}
+
+}
+#endif /* STARTING_POINTS_H_ */
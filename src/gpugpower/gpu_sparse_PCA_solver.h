@@ -19,6 +19,7 @@
 
 #include "../class/optimization_settings.h"
 #include "../utils/termination_criteria.h"
+#include "../utils/counter_rng.h"
 #include "gpu_headers.h"
 
 namespace SPCASolver {
@@ -74,9 +75,13 @@ int denseDataSolver(cublasHandle_t &handle, const unsigned int m,
 		}
 		for (int i = 0; i < optimizationSettings->constraintParameter; i++) {
 			for (int j = 0; j < optimizationSettings->totalStartingPoints; j++) {
-				int tmp_idx = n * (rand() / (RAND_MAX + 0.0));
-				tmp_idx = (tmp_idx == n ? tmp_idx-- : tmp_idx);
-				d_V[tmp_idx + j * LD_N] = rand() / (0.0 + RAND_MAX);
+				// stream layout of getSignleStartingPoint (multicore solver)
+				int tmp_idx = n
+						* counter_rng_uniform<double>(optimizationSettings->seed,
+								j, 2 * i);
+				tmp_idx = (tmp_idx >= n ? n - 1 : tmp_idx);
+				d_V[tmp_idx + j * LD_N] = counter_rng_uniform<F>(
+						optimizationSettings->seed, j, 2 * i + 1);
 			}
 		}
 	}
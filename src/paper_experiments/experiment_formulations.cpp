@@ -0,0 +1,90 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  Time of one iteration (of one starting point) for every formulation and
+ *  precision. All points run maximumIterations (tolerance 0), so the amount
+ *  of work does not depend on convergence. Uses only the public solver
+ *  interface, hence builds of different versions can be compared.
+ *  Output: precision (bytes), formulation, m, n, objective value, total
+ *  time, time per iteration of one point (microseconds)
+ *
+ */
+
+#include "../class/optimization_settings.h"
+#include "../class/optimization_statistics.h"
+using namespace SolverStructures;
+#include "../gpower/sparse_PCA_solver.h"
+#include "../utils/timer.h"
+#include "../problem_generators/gpower_problem_generator.h"
+#include <fstream>
+
+template<typename F>
+void run_experiments(OptimizationSettings* optimizationSettings, const int m,
+		const int n, ofstream& fileOut) {
+	OptimizationStatistics* optimizationStatistics = new OptimizationStatistics();
+	std::vector<F> B((size_t) m * n);
+	std::vector<F> x(n);
+	generateProblem(n, m, &B[0], m, n, true);
+	F maxNorm = 0;
+	for (int j = 0; j < n; j++)
+		maxNorm = std::max(maxNorm, cblas_l2_norm(m, &B[(size_t) m * j], 1));
+	for (int f = 0; f < 8; f++) {
+		optimizationSettings->formulation = (SPCA_Formulation) f;
+		if (optimizationSettings->formulation == L0_penalized_L2_PCA)
+			optimizationSettings->penaltyParameter = 0.01 * maxNorm * maxNorm;
+		else if (optimizationSettings->formulation == L1_penalized_L2_PCA)
+			optimizationSettings->penaltyParameter = 0.05 * maxNorm;
+		else
+			optimizationSettings->penaltyParameter =
+					optimizationSettings->isL1PenalizedProblem() ? 0.5 : 0.05;
+		double best = 0;
+		F value = 0;
+		// best of 3 runs
+		for (int run = 0; run < 3; run++) {
+			value = SPCASolver::MulticoreSolver::denseDataSolver(&B[0], m,
+					&x[0], m, n, optimizationSettings, optimizationStatistics);
+			if (run == 0
+					|| optimizationStatistics->totalTrueComputationTime < best)
+				best = optimizationStatistics->totalTrueComputationTime;
+		}
+		const double perIteration = best * 1e6
+				/ ((double) optimizationSettings->totalStartingPoints
+						* optimizationSettings->maximumIterations);
+		cout << sizeof(F) << "," << optimizationSettings->formulation << ","
+				<< m << "," << n << "," << value << "," << best << ","
+				<< perIteration << endl;
+		fileOut << sizeof(F) << "," << optimizationSettings->formulation << ","
+				<< m << "," << n << "," << value << "," << best << ","
+				<< perIteration << endl;
+	}
+	delete optimizationStatistics;
+}
+
+int main(int argc, char *argv[]) {
+	OptimizationSettings* optimizationSettings = new OptimizationSettings();
+	optimizationSettings->maximumIterations = 20;
+	optimizationSettings->tolerance = 0;
+	optimizationSettings->totalStartingPoints = 256;
+	optimizationSettings->batchSize = 64;
+	optimizationSettings->constraintParameter = 20;
+	optimizationSettings->gramMatrixMode = NoGramMatrix;
+	ofstream fileOut;
+	fileOut.open("results/paper_experiment_formulations.txt");
+	// small m: the per-column work after the products is a large part
+	run_experiments<float>(optimizationSettings, 100, 5000, fileOut);
+	run_experiments<double>(optimizationSettings, 100, 5000, fileOut);
+	run_experiments<float>(optimizationSettings, 1000, 5000, fileOut);
+	run_experiments<double>(optimizationSettings, 1000, 5000, fileOut);
+	fileOut.close();
+	delete optimizationSettings;
+	return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  Accuracy report of 16-bit storage of B (bfloat16, fp16) against the
+ *  full precision solver. For every formulation and storage:
+ *  Output: precision of computation (bytes), formulation, storage, objective
+ *  value reported by the solver, objective value of its solution on full
+ *  precision B, its relative gap to the same value of the full precision
+ *  solution,
+ *  size of intersection of supports with the full precision solution / its
+ *  cardinality, computation time, memory used by B (MB)
+ *
+ */
+
+#include "../class/optimization_settings.h"
+#include "../class/optimization_statistics.h"
+using namespace SolverStructures;
+#include "../gpower/sparse_PCA_solver.h"
+#include "../utils/timer.h"
+#include "../problem_generators/gpower_problem_generator.h"
+#include <fstream>
+
+template<typename F>
+void run_experiments(OptimizationSettings* optimizationSettings,
+		ofstream& fileOut) {
+	OptimizationStatistics* optimizationStatistics = new OptimizationStatistics();
+	const int m = 2000;
+	const int n = 8000;
+	std::vector<F> B((size_t) m * n);
+	std::vector<F> x(n);
+	std::vector<F> x_full(n);
+	generateProblem(n, m, &B[0], m, n, true);
+	F maxNorm = 0;
+	for (int j = 0; j < n; j++)
+		maxNorm = std::max(maxNorm, cblas_l2_norm(m, &B[(size_t) m * j], 1));
+	for (int f = 0; f < 8; f++) {
+		optimizationSettings->formulation = (SPCA_Formulation) f;
+		if (optimizationSettings->formulation == L0_penalized_L2_PCA)
+			optimizationSettings->penaltyParameter = 0.01 * maxNorm * maxNorm;
+		else if (optimizationSettings->formulation == L1_penalized_L2_PCA)
+			optimizationSettings->penaltyParameter = 0.05 * maxNorm;
+		else
+			optimizationSettings->penaltyParameter =
+					optimizationSettings->isL1PenalizedProblem() ? 0.5 : 0.05;
+		SPCASolver::MulticoreSolver::denseDataSolver(&B[0], m, &x_full[0], m,
+				n, optimizationSettings, optimizationStatistics);
+		const F full_value = SPCASolver::MulticoreSolver::evaluateSolution(
+				&B[0], m, &x_full[0], m, n, optimizationSettings);
+		const int nnz = vector_get_nnz(&x_full[0], n);
+		for (int storage = FullPrecisionStorage; storage <= Float16Storage;
+				storage++) {
+			F value = optimizationStatistics->fval;
+			size_t bytes = sizeof(F) * B.size();
+			if (storage == FullPrecisionStorage) {
+				cblas_vector_copy(n, &x_full[0], 1, &x[0], 1);
+			} else {
+				ReducedPrecisionMatrix<F> B_reduced;
+				B_reduced.store(&B[0], m, m, n, (StoragePrecision) storage);
+				bytes = B_reduced.bytes();
+				value = SPCASolver::MulticoreSolver::reducedPrecisionSolver(
+						B_reduced, &x[0], optimizationSettings,
+						optimizationStatistics);
+			}
+			F value_on_full = SPCASolver::MulticoreSolver::evaluateSolution(
+					&B[0], m, &x[0], m, n, optimizationSettings);
+			int common = 0;
+			for (int i = 0; i < n; i++)
+				if (x[i] != 0 && x_full[i] != 0)
+					common++;
+			cout << sizeof(F) << "," << optimizationSettings->formulation << ","
+					<< storage << "," << value << "," << value_on_full << ","
+					<< (full_value - value_on_full) / full_value << "," << common
+					<< "/" << nnz << ","
+					<< optimizationStatistics->totalTrueComputationTime << ","
+					<< bytes / 1048576.0 << endl;
+			fileOut << sizeof(F) << "," << optimizationSettings->formulation
+					<< "," << storage << "," << value << "," << value_on_full
+					<< "," << (full_value - value_on_full) / full_value << ","
+					<< common << "/" << nnz << ","
+					<< optimizationStatistics->totalTrueComputationTime << ","
+					<< bytes / 1048576.0 << endl;
+		}
+	}
+	delete optimizationStatistics;
+}
+
+int main(int argc, char *argv[]) {
+	OptimizationSettings* optimizationSettings = new OptimizationSettings();
+	optimizationSettings->maximumIterations = 50;
+	optimizationSettings->tolerance = 0.0001;
+	optimizationSettings->totalStartingPoints = 64;
+	optimizationSettings->batchSize = 64;
+	optimizationSettings->constraintParameter = 20;
+	optimizationSettings->gramMatrixMode = NoGramMatrix;
+	ofstream fileOut;
+	fileOut.open("results/paper_experiment_reduced_precision.txt");
+	run_experiments<float>(optimizationSettings, fileOut);
+	run_experiments<double>(optimizationSettings, fileOut);
+	fileOut.close();
+	delete optimizationSettings;
+	return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  Compares the sort based and the selection based search for the
+ *  soft-thresholding parameter used by L1 constrained formulations.
+ *  Output: n, constrain, w (sort), w (selection), relative difference,
+ *  constraint violation of both, time (sort), time (selection)
+ *
+ *  A case fails if the selection based w does not satisfy
+ *  \|y\|_1 = sqrt(constrain) \|y\|_2 (or y = x if x is already feasible), or
+ *  if it differs from a sort based w which does.
+ *
+ */
+
+#include "../class/optimization_settings.h"
+#include "../class/optimization_statistics.h"
+using namespace SolverStructures;
+#include "../utils/thresh_functions.h"
+#include "../utils/timer.h"
+#include <fstream>
+
+/*
+ * Relative violation of \|y\|_1 <= sqrt(constrain) \|y\|_2 (with equality if
+ * w > 0) for y = (|x| - w)_+ sgn(x)
+ */
+template<typename F>
+F constraint_violation(const std::vector<F>& x, const F w,
+		const unsigned int constrain) {
+	F l1 = 0;
+	F l2 = 0;
+	for (unsigned int i = 0; i < x.size(); i++) {
+		F tmp = std::fabs(x[i]) - w;
+		if (tmp > 0) {
+			l1 += tmp;
+			l2 += tmp * tmp;
+		}
+	}
+	if (!(l2 > 0))
+		return 1; // y = 0 is never a valid projection
+	F violation = (l1 - sqrt(constrain + 0.0) * sqrt(l2)) / l1;
+	return (w > 0) ? std::fabs(violation) : std::max(violation, (F) 0);
+}
+
+template<typename F>
+int run_experiments(OptimizationSettings* optimizationSettings) {
+	ofstream fileOut;
+	fileOut.open("results/paper_experiment_soft_thresholding.txt");
+	mytimer* mt = new mytimer();
+	const F tolerance = 1e-6;
+	const int repeats = 20;
+	int failures = 0;
+	std::vector<F> x;
+	std::vector<F> buffer;
+	srand(1);
+	for (unsigned int n = 1000; n <= 1024000; n = n * 4) {
+		x.resize(n);
+		buffer.resize(n);
+		for (unsigned int i = 0; i < n; i++) {
+			// heavy tailed, like a typical B^T y
+			F u = (F) rand() / RAND_MAX;
+			F v = (F) rand() / RAND_MAX;
+			x[i] = (2 * u - 1) / (v + 0.01);
+		}
+		for (unsigned int constrain = 1; constrain <= n; constrain = constrain
+				* 10) {
+			F wSort = 0;
+			F wSelect = 0;
+			mt->start();
+			for (int r = 0; r < repeats; r++)
+				wSort = find_soft_treshHolding_parameter_with_sorting(&x[0], n,
+						constrain, buffer, optimizationSettings);
+			mt->end();
+			double timeSort = mt->getElapsedWallClockTime() / repeats;
+			mt->start();
+			for (int r = 0; r < repeats; r++)
+				wSelect = find_soft_treshHolding_parameter_with_selection(&x[0],
+						n, constrain, buffer);
+			mt->end();
+			double timeSelect = mt->getElapsedWallClockTime() / repeats;
+			F difference = std::fabs(wSort - wSelect)
+					/ std::max(std::fabs(wSort), (F) 1);
+			F violationSort = constraint_violation(x, wSort, constrain);
+			F violationSelect = constraint_violation(x, wSelect, constrain);
+			if (violationSelect > tolerance
+					|| (difference > tolerance && violationSort <= tolerance))
+				failures++;
+			cout << n << "," << constrain << "," << wSort << "," << wSelect
+					<< "," << difference << "," << violationSort << ","
+					<< violationSelect << "," << timeSort << "," << timeSelect
+					<< endl;
+			fileOut << n << "," << constrain << "," << wSort << "," << wSelect
+					<< "," << difference << "," << violationSort << ","
+					<< violationSelect << "," << timeSort << "," << timeSelect
+					<< endl;
+		}
+	}
+	fileOut.close();
+	delete mt;
+	if (failures > 0)
+		cout << failures << " cases differ by more than " << tolerance << endl;
+	return failures;
+}
+
+int main(int argc, char *argv[]) {
+	OptimizationSettings* optimizationSettings = new OptimizationSettings();
+	int failures = run_experiments<double>(optimizationSettings);
+	delete optimizationSettings;
+	return failures > 0;
+}
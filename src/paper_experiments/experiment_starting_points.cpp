@@ -0,0 +1,88 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  Compares starting point strategies for penalized formulations with growing
+ *  penalty parameter (given as a fraction of the largest value for which the
+ *  solution is nonzero: max_i \|b_i\|^2 for L0, max_i \|b_i\| for L1 penalty).
+ *  Output: formulation, penalty fraction, strategy, best objective value,
+ *  total iterations, computation time, cardinality of the best point
+ *
+ */
+
+#include "../class/optimization_settings.h"
+#include "../class/optimization_statistics.h"
+using namespace SolverStructures;
+#include "../gpower/sparse_PCA_solver.h"
+#include "../utils/timer.h"
+#include "../problem_generators/gpower_problem_generator.h"
+#include <fstream>
+
+template<typename F>
+void run_experiments(OptimizationSettings* optimizationSettings) {
+	OptimizationStatistics* optimizationStatistics = new OptimizationStatistics();
+	ofstream fileOut;
+	fileOut.open("results/paper_experiment_starting_points.txt");
+	const int m = 500;
+	const int n = 5000;
+	std::vector<F> B((size_t) m * n);
+	std::vector<F> x(n);
+	generateProblem(n, m, &B[0], m, n, true); // columns with different norms
+	F maxNorm = 0;
+	for (int j = 0; j < n; j++)
+		maxNorm = std::max(maxNorm, cblas_l2_norm(m, &B[(size_t) m * j], 1));
+	optimizationSettings->maximumIterations = 100;
+	optimizationSettings->tolerance = 0.0001;
+	optimizationSettings->totalStartingPoints = 256;
+	optimizationSettings->batchSize = 64;
+	optimizationSettings->useOTF = true;
+	optimizationSettings->constraintParameter = 10;
+	SPCA_Formulation formulations[2] = { L0_penalized_L2_PCA,
+			L1_penalized_L2_PCA };
+	const double fractions[4] = { 0.01, 0.05, 0.2, 0.6 };
+	for (int f = 0; f < 2; f++) {
+		optimizationSettings->formulation = formulations[f];
+		for (int g = 0; g < 4; g++) {
+			optimizationSettings->penaltyParameter = fractions[g]
+					* (optimizationSettings->isL1PenalizedProblem() ?
+							maxNorm : maxNorm * maxNorm);
+			for (int strategy = RandomStartingPoints;
+					strategy <= SketchStartingPoints; strategy++) {
+				optimizationSettings->startingPointStrategy =
+						(StartingPointStrategy) strategy;
+				F value = SPCASolver::MulticoreSolver::denseDataSolver(&B[0], m,
+						&x[0], m, n, optimizationSettings,
+						optimizationStatistics);
+				int nnz = vector_get_nnz(&x[0], n);
+				cout << optimizationSettings->formulation << ","
+						<< fractions[g] << "," << strategy << "," << value
+						<< "," << optimizationStatistics->it << ","
+						<< optimizationStatistics->totalTrueComputationTime
+						<< "," << nnz << endl;
+				fileOut << optimizationSettings->formulation << ","
+						<< fractions[g] << "," << strategy << "," << value
+						<< "," << optimizationStatistics->it << ","
+						<< optimizationStatistics->totalTrueComputationTime
+						<< "," << nnz << endl;
+			}
+		}
+	}
+	fileOut.close();
+	delete optimizationStatistics;
+}
+
+int main(int argc, char *argv[]) {
+	OptimizationSettings* optimizationSettings = new OptimizationSettings();
+	init_random_seeds();
+	run_experiments<double>(optimizationSettings);
+	delete optimizationSettings;
+	return 0;
+}
@@ -22,7 +22,6 @@ using namespace SolverStructures;
 #include "../problem_generators/gpower_problem_generator.h"
 #include "experiment_utils.h"
 #include "../problem_generators/data_generation.h"
-#include "mkl_types.h"
 #include "../gpower/sparse_PCA_solver_for_CSC.h"
 
 template<typename F>
@@ -33,32 +32,23 @@ void run_experiments(OptimizationSettings* optimizationSettings, const char* fil
 	fileOut.open(logfilename);
 	mytimer* mt = new mytimer();
 	std::vector<F> B_CSC_Vals;
-	std::vector < MKL_INT > B_CSC_Row_Id;
-	std::vector < MKL_INT > B_CSC_Col_Ptr;
+	std::vector<int> B_CSC_Row_Id;
+	std::vector<int> B_CSC_Col_Ptr;
 	std::vector<F> means;
 	int m = -1;
 	int n = -1;
 	bool doMean = true;
 	load_doc_data(filename, n, m, B_CSC_Vals, B_CSC_Row_Id, B_CSC_Col_Ptr,
 			means, doMean);
-	std::vector<F> x;
-	x.resize(n);
-
-	for (int i = 0; i < 10; i++) {
-		SPCASolver::sparse_PCA_solver_CSC(&B_CSC_Vals[0], &B_CSC_Row_Id[0],
-				&B_CSC_Col_Ptr[0], &x[0], m, n, optimizationSettings, optimizationStatistics, doMean,
-				&means[0]);
-		printDescriptions(&x[0], n, description, optimizationStatistics, fileOut);
-		for (int col = 0; col < n; col++) {
-			if (x[col] != 0) {
-				means[col] = 0;
-				for (int r = B_CSC_Col_Ptr[col]; r < B_CSC_Col_Ptr[col + 1];
-						r++) {
-					B_CSC_Vals[r] = 0;
-				}
-			}
-		}
-
+	const unsigned int components = 10;
+	std::vector<F> X((size_t) n * components);
+	SPCASolver::solveComponents(&B_CSC_Vals[0], &B_CSC_Row_Id[0],
+			&B_CSC_Col_Ptr[0], &X[0], m, n, components, optimizationSettings,
+			optimizationStatistics, doMean, &means[0], false, (F*) NULL);
+	for (unsigned int c = 0; c < components; c++) {
+		optimizationStatistics->fval = optimizationStatistics->componentValues[c];
+		printDescriptions(&X[(size_t) n * c], n, description,
+				optimizationStatistics, fileOut);
 	}
 	fileOut.close();
 }
@@ -69,6 +59,8 @@ int main(int argc, char *argv[]) {
 	optimizationSettings->maximumIterations = 50;
 	optimizationSettings->tolerance = 0.0001;
 	optimizationSettings->totalStartingPoints = 1024;
+	optimizationSettings->batchSize = 64;
+	optimizationSettings->useOTF = true;
 	optimizationSettings->constraintParameter = 5;
 	optimizationSettings->formulation = L0_constrained_L2_PCA;
 
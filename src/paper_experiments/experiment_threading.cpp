@@ -0,0 +1,94 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  Threading of the per-column work (see execution_policy.h): for 1..64
+ *  threads (at most the number of processors) and batch sizes 1..1024, one
+ *  batch is iterated maximumIterations times (tolerance 0) with threading
+ *  across starting points, within a vector and automatic.
+ *  Output: formulation, threads, batch size, threading mode, mode chosen by
+ *  the automatic policy in the first iteration, objective value, total time,
+ *  time per iteration of one point (microseconds)
+ *
+ */
+
+#include "../class/optimization_settings.h"
+#include "../class/optimization_statistics.h"
+using namespace SolverStructures;
+#include "../gpower/sparse_PCA_solver.h"
+#include "../utils/timer.h"
+#include "../problem_generators/gpower_problem_generator.h"
+#include <fstream>
+
+template<typename F>
+void run_experiments(OptimizationSettings* optimizationSettings,
+		const SPCA_Formulation formulation, const int m, const int n,
+		ofstream& fileOut) {
+	OptimizationStatistics* optimizationStatistics = new OptimizationStatistics();
+	std::vector<F> B((size_t) m * n);
+	std::vector<F> x(n);
+	generateProblem(n, m, &B[0], m, n, true);
+	optimizationSettings->formulation = formulation;
+	const int processors = omp_get_num_procs();
+	for (int threads = 1; threads <= 64 && threads <= processors; threads *=
+			2) {
+		omp_set_num_threads(threads);
+		init_random_seeds();
+		for (int batch = 1; batch <= 1024; batch *= 4) {
+			optimizationSettings->batchSize = batch;
+			optimizationSettings->totalStartingPoints = batch;
+			ExecutionPolicy automatic;
+			automatic.decide(AutomaticThreading, batch, m, n,
+					optimizationSettings->isConstrainedProblem());
+			const int chosen =
+					(automatic.vectorThreads > 1) ?
+							VectorThreading : ColumnThreading;
+			for (int mode = AutomaticThreading; mode <= VectorThreading;
+					mode++) {
+				optimizationSettings->threadingMode = (ThreadingMode) mode;
+				F value = SPCASolver::MulticoreSolver::denseDataSolver(&B[0],
+						m, &x[0], m, n, optimizationSettings,
+						optimizationStatistics);
+				const double time =
+						optimizationStatistics->totalTrueComputationTime;
+				const double perIteration = time * 1e6
+						/ ((double) batch
+								* optimizationSettings->maximumIterations);
+				cout << formulation << "," << threads << "," << batch << ","
+						<< mode << "," << chosen << "," << value << "," << time
+						<< "," << perIteration << endl;
+				fileOut << formulation << "," << threads << "," << batch << ","
+						<< mode << "," << chosen << "," << value << "," << time
+						<< "," << perIteration << endl;
+			}
+		}
+	}
+	delete optimizationStatistics;
+}
+
+int main(int argc, char *argv[]) {
+	OptimizationSettings* optimizationSettings = new OptimizationSettings();
+	optimizationSettings->maximumIterations = 10;
+	optimizationSettings->tolerance = 0;
+	optimizationSettings->constraintParameter = 100;
+	optimizationSettings->penaltyParameter = 0.5;
+	optimizationSettings->gramMatrixMode = NoGramMatrix;
+	ofstream fileOut;
+	fileOut.open("results/paper_experiment_threading.txt");
+	// long columns (n), so that splitting a column can pay off
+	run_experiments<float>(optimizationSettings, L1_penalized_L1_PCA, 200,
+			50000, fileOut);
+	run_experiments<float>(optimizationSettings, L0_constrained_L2_PCA, 200,
+			50000, fileOut);
+	fileOut.close();
+	delete optimizationSettings;
+	return 0;
+}
@@ -17,6 +17,227 @@
 #define DATA_GENERATION_H_
 
 #include "../utils/matrix_conversions.h"
+#include "../utils/mapped_file.h"
+#include <string>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define DOC_CSC_CACHE_MAGIC "24AMCSC"
+#define DOC_CSC_CACHE_VERSION 1
+#define DOC_CSC_CACHE_SUFFIX ".csc.bin"
+
+/*
+ * Header of the binary sidecar file which caches the CSC matrix loaded from
+ * UCI bag-of-words file. The cache is valid only if size and modification
+ * time of the docword file did not change.
+ */
+class DocCSCCacheHeader {
+public:
+	char magic[8];
+	unsigned int version;
+	unsigned int valueSize; // sizeof(F)
+	unsigned int indexSize; // sizeof(I)
+	unsigned int reserved;
+	long long m;
+	long long n;
+	long long nnz;
+	long long sourceSize;
+	long long sourceModificationTime;
+
+	DocCSCCacheHeader() {
+		memset(this, 0, sizeof(DocCSCCacheHeader));
+	}
+};
+
+inline long long parse_doc_integer(const char*& p, const char* end) {
+	while (p < end && (*p < '0' || *p > '9'))
+		p++;
+	long long value = 0;
+	while (p < end && *p >= '0' && *p <= '9') {
+		value = value * 10 + (*p - '0');
+		p++;
+	}
+	return value;
+}
+
+template<typename F, typename I>
+bool fill_doc_cache_header(const char* filename, DocCSCCacheHeader& header) {
+	struct stat fileStat;
+	if (stat(filename, &fileStat) != 0)
+		return false;
+	strncpy(header.magic, DOC_CSC_CACHE_MAGIC, sizeof(header.magic));
+	header.version = DOC_CSC_CACHE_VERSION;
+	header.valueSize = sizeof(F);
+	header.indexSize = sizeof(I);
+	header.sourceSize = fileStat.st_size;
+	header.sourceModificationTime = fileStat.st_mtime;
+	return true;
+}
+
+template<typename F, typename I>
+bool load_doc_CSC_cache(const char* filename, int& n, int& m,
+		std::vector<F>& B_CSC_Vals, std::vector<I> &B_CSC_Row_Id,
+		std::vector<I> &B_CSC_Col_Ptr) {
+	DocCSCCacheHeader expected;
+	if (!fill_doc_cache_header<F, I>(filename, expected))
+		return false;
+	std::string cacheFile = std::string(filename) + DOC_CSC_CACHE_SUFFIX;
+	FILE* fin = fopen(cacheFile.c_str(), "rb");
+	if (fin == NULL)
+		return false;
+	DocCSCCacheHeader header;
+	bool valid = fread(&header, sizeof(DocCSCCacheHeader), 1, fin) == 1
+			&& strncmp(header.magic, expected.magic, sizeof(header.magic)) == 0
+			&& header.version == expected.version
+			&& header.valueSize == expected.valueSize
+			&& header.indexSize == expected.indexSize
+			&& header.sourceSize == expected.sourceSize
+			&& header.sourceModificationTime
+					== expected.sourceModificationTime;
+	if (valid) {
+		m = header.m;
+		n = header.n;
+		B_CSC_Vals.resize(header.nnz);
+		B_CSC_Row_Id.resize(header.nnz);
+		B_CSC_Col_Ptr.resize(header.n + 1);
+		valid = fread(&B_CSC_Col_Ptr[0], sizeof(I), header.n + 1, fin)
+				== (size_t) header.n + 1
+				&& fread(&B_CSC_Row_Id[0], sizeof(I), header.nnz, fin)
+						== (size_t) header.nnz
+				&& fread(&B_CSC_Vals[0], sizeof(F), header.nnz, fin)
+						== (size_t) header.nnz;
+	}
+	fclose(fin);
+	return valid;
+}
+
+template<typename F, typename I>
+void save_doc_CSC_cache(const char* filename, int n, int m,
+		std::vector<F>& B_CSC_Vals, std::vector<I> &B_CSC_Row_Id,
+		std::vector<I> &B_CSC_Col_Ptr) {
+	DocCSCCacheHeader header;
+	if (!fill_doc_cache_header<F, I>(filename, header))
+		return;
+	header.m = m;
+	header.n = n;
+	header.nnz = B_CSC_Vals.size();
+	std::string cacheFile = std::string(filename) + DOC_CSC_CACHE_SUFFIX;
+	FILE* fout = fopen(cacheFile.c_str(), "wb");
+	if (fout == NULL)
+		return; // cache is optional (e.g. read-only dataset folder)
+	bool ok = fwrite(&header, sizeof(DocCSCCacheHeader), 1, fout) == 1
+			&& fwrite(&B_CSC_Col_Ptr[0], sizeof(I), n + 1, fout)
+					== (size_t) n + 1
+			&& fwrite(&B_CSC_Row_Id[0], sizeof(I), header.nnz, fout)
+					== (size_t) header.nnz
+			&& fwrite(&B_CSC_Vals[0], sizeof(F), header.nnz, fout)
+					== (size_t) header.nnz;
+	fclose(fout);
+	if (!ok)
+		remove(cacheFile.c_str());
+}
+
+/*
+ * Loads UCI bag-of-words file (docword.*.txt) directly into CSC format.
+ * Every thread parses its part of the mapped file twice: first it counts
+ * entries per column, then (after the column pointers and the offsets of
+ * every thread inside every column are known) it writes its entries to
+ * their final position. Order of rows inside a column is the same as in
+ * the file.
+ */
+template<typename F, typename I>
+int load_doc_CSC_from_docword(const char* filename, int& n, int& m,
+		std::vector<F>& B_CSC_Vals, std::vector<I> &B_CSC_Row_Id,
+		std::vector<I> &B_CSC_Col_Ptr) {
+	InputOuputHelper::MappedFile file;
+	if (file.map(filename) != 0 || file.length == 0)
+		return 1;
+	const char* p = file.data;
+	const char* end = file.data + file.length;
+	m = parse_doc_integer(p, end);
+	n = parse_doc_integer(p, end);
+	const long long nnz = parse_doc_integer(p, end);
+	const size_t bodyStart = p - file.data;
+
+	int parts = 1;
+#ifdef _OPENMP
+	parts = omp_get_max_threads();
+#endif
+	std::vector<size_t> partStarts(parts + 1);
+	partStarts[0] = bodyStart;
+	for (int part = 1; part < parts; part++) {
+		size_t position = bodyStart
+				+ ((file.length - bodyStart) / parts) * part;
+		if (position < partStarts[part - 1])
+			position = partStarts[part - 1];
+		while (position < file.length && file.data[position - 1] != '\n')
+			position++;
+		partStarts[part] = position;
+	}
+	partStarts[parts] = file.length;
+
+	// histogram of columns for every part
+	std::vector<long long> counts((size_t) parts * n, 0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static,1)
+#endif
+	for (int part = 0; part < parts; part++) {
+		long long* partCounts = &counts[(size_t) part * n];
+		const char* q = file.data + partStarts[part];
+		const char* partEnd = file.data + partStarts[part + 1];
+		while (true) {
+			parse_doc_integer(q, partEnd); // row
+			long long col = parse_doc_integer(q, partEnd);
+			parse_doc_integer(q, partEnd); // value
+			if (q >= partEnd && col == 0)
+				break;
+			if (col >= 1 && col <= n)
+				partCounts[col - 1]++;
+		}
+	}
+
+	// column pointers; counts are turned into offset of each part in a column
+	B_CSC_Col_Ptr.resize(n + 1);
+	long long total = 0;
+	for (int col = 0; col < n; col++) {
+		B_CSC_Col_Ptr[col] = total;
+		for (int part = 0; part < parts; part++) {
+			long long tmp = counts[(size_t) part * n + col];
+			counts[(size_t) part * n + col] = total;
+			total += tmp;
+		}
+	}
+	B_CSC_Col_Ptr[n] = total;
+	if (total != nnz) {
+		printf("Expected %lld nonzeros, found %lld\n", nnz, total);
+	}
+	B_CSC_Vals.resize(total);
+	B_CSC_Row_Id.resize(total);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static,1)
+#endif
+	for (int part = 0; part < parts; part++) {
+		long long* partOffsets = &counts[(size_t) part * n];
+		const char* q = file.data + partStarts[part];
+		const char* partEnd = file.data + partStarts[part + 1];
+		while (true) {
+			long long row = parse_doc_integer(q, partEnd);
+			long long col = parse_doc_integer(q, partEnd);
+			long long val = parse_doc_integer(q, partEnd);
+			if (q >= partEnd && col == 0)
+				break;
+			if (col < 1 || col > n)
+				continue;
+			long long position = partOffsets[col - 1]++;
+			B_CSC_Row_Id[position] = row - 1;
+			B_CSC_Vals[position] = val;
+		}
+	}
+	return 0;
+}
 
 template<typename F>
 int load_doc_data(const char* filename, int& n, int& m, std::vector<F>& B) {
@@ -99,71 +320,44 @@ int load_doc_data(const char* filename, int& n, int& m, std::vector<F>& B) {
 	return 0;
 }
 
+/*
+ * Loads UCI bag-of-words file into CSC format. The parsed matrix is cached in
+ * binary file "filename.csc.bin" and next runs load the cache instead.
+ */
 template<typename F, typename I>
 int load_doc_data(const char* filename, int& n, int& m,
 		std::vector<F>& B_CSC_Vals, std::vector<I> &B_CSC_Row_Id,
 		std::vector<I> &B_CSC_Col_Ptr, std::vector<F>& means, bool doMeans) {
-	FILE * fin = fopen(filename, "r");
-	int nnz = -1;
-	int row = -1;
-	int col = -1;
-	int val = -1;
-	if (fin == NULL) {
-		printf("File not found\n");
-		exit(1);
-	} else {
-		fscanf(fin, "%d", &m);
-		fscanf(fin, "%d", &n);
-		fscanf(fin, "%d", &nnz);
-
-		std::vector<F> B_COO_Vals(nnz, 0);
-		std::vector<I> B_COO_Col_Id(nnz, 0);
-		std::vector<I> B_COO_Row_Id(nnz, 0);
-
-		for (int k = 0; k < nnz; k++) {
-			fscanf(fin, "%d %d %d\n", &row, &col, &val);
-			row--;
-			col--;
-
-			B_COO_Row_Id[k] = row;
-			B_COO_Col_Id[k] = col;
-			B_COO_Vals[k] = val;
+	int col;
+	if (!load_doc_CSC_cache(filename, n, m, B_CSC_Vals, B_CSC_Row_Id,
+			B_CSC_Col_Ptr)) {
+		if (load_doc_CSC_from_docword(filename, n, m, B_CSC_Vals, B_CSC_Row_Id,
+				B_CSC_Col_Ptr) != 0) {
+			printf("File not found\n");
+			exit(1);
 		}
-		//		for (j = 0; j < DIM_M; j++) {
-		//			for (i = 0; i < DIM_N; i++) {
-		//				float tmp = -1;
-		//				fscanf(fin, "%f;", &tmp);
-		//				gsl_matrix_set(B, j, i, tmp);
-		//				gsl_matrix_set(BT, i, j, tmp);
-		//			}
-		//		}
-		fclose(fin);
-		getCSC_from_COO(B_COO_Vals, B_COO_Row_Id, B_COO_Col_Id, B_CSC_Vals,
-				B_CSC_Row_Id, B_CSC_Col_Ptr, m, n);
-
-		//		for (int i=0;i<nnz;i++){
-		//			printf("ZZZIII %d %d %f\n",B_CSC_Row_Id[i],B_CSC_Col_Ptr[i],B_CSC_Vals[i]);
-		//		}
-		//		printf("ZZZIII %d \n",B_CSC_Col_Ptr[n]);
-
-
+		save_doc_CSC_cache(filename, n, m, B_CSC_Vals, B_CSC_Row_Id,
+				B_CSC_Col_Ptr);
 	}
 
 	if (doMeans) {
 		means.resize(n);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
 		for (col = 0; col < n; col++) {
 			means[col] = 0;
-			for (row = B_CSC_Col_Ptr[col]; row < B_CSC_Col_Ptr[col + 1]; row++) {
+			for (I row = B_CSC_Col_Ptr[col]; row < B_CSC_Col_Ptr[col + 1]; row++) {
 				means[col] += B_CSC_Vals[row];
 			}
 			means[col] = means[col] / (0.0 + m);
-			for (row = B_CSC_Col_Ptr[col]; row < B_CSC_Col_Ptr[col + 1]; row++) {
+			for (I row = B_CSC_Col_Ptr[col]; row < B_CSC_Col_Ptr[col + 1]; row++) {
 				B_CSC_Vals[row] = B_CSC_Vals[row] - means[col];
 			}
 		}
 	}
 
-	for (col = 0; col < n; col++) {
+	for (col = 0; col < n && doMeans; col++) {
 //		F norm = 0;
 //		for (row = B_CSC_Col_Ptr[col]; row < B_CSC_Col_Ptr[col + 1]; row++) {
 //			norm += B_CSC_Vals[row] * B_CSC_Vals[row];
@@ -0,0 +1,209 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  Binary matrix format. The file starts with BinaryMatrixHeader and the
+ *  matrix itself is stored column-major (Fortran based) at "dataOffset".
+ *  Leading dimension ldB >= m is padded such that every column starts at an
+ *  "alignment"-byte boundary, hence the mapped pointer can be passed directly
+ *  to the solver (no copy, no parsing).
+ *
+ */
+
+#ifndef BINARY_MATRIX_FILE_H_
+#define BINARY_MATRIX_FILE_H_
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "mapped_file.h"
+
+namespace InputOuputHelper {
+
+#define BINARY_MATRIX_MAGIC "24AMMAT"
+#define BINARY_MATRIX_VERSION 1
+#define BINARY_MATRIX_DEFAULT_ALIGNMENT 64
+#define BINARY_MATRIX_DATA_OFFSET 4096
+
+class BinaryMatrixHeader {
+public:
+	char magic[8]; // BINARY_MATRIX_MAGIC
+	unsigned int version; // format version
+	unsigned int precision; // size of one element in bytes (4 = float, 8 = double)
+	unsigned long long m; // number of rows
+	unsigned long long n; // number of columns
+	unsigned long long ldB; // leading dimension (in elements)
+	unsigned long long alignment; // alignment of columns (in bytes)
+	unsigned long long dataOffset; // position of first element in file (in bytes)
+
+	BinaryMatrixHeader() {
+		memset(this, 0, sizeof(BinaryMatrixHeader));
+	}
+};
+
+// returns true if file starts with the binary matrix header
+bool is_binary_matrix_file(const char* filename) {
+	BinaryMatrixHeader header;
+	FILE* fin = fopen(filename, "rb");
+	if (fin == NULL)
+		return false;
+	size_t read = fread(&header, sizeof(BinaryMatrixHeader), 1, fin);
+	fclose(fin);
+	return read == 1
+			&& strncmp(header.magic, BINARY_MATRIX_MAGIC, sizeof(header.magic))
+					== 0;
+}
+
+/*
+ * Dimensions are used as (unsigned) int by the solver and BLAS, the data
+ * have to fit into the address range behind dataOffset.
+ */
+bool has_valid_dimensions(const BinaryMatrixHeader& header) {
+	if (header.m > INT_MAX || header.n > INT_MAX || header.ldB > INT_MAX
+			|| header.ldB < header.m || header.precision == 0
+			|| header.dataOffset < sizeof(BinaryMatrixHeader))
+		return false;
+	return header.ldB == 0
+			|| header.n
+					<= (ULLONG_MAX - header.dataOffset) / header.precision
+							/ header.ldB;
+}
+
+/**
+ * @return 0 on success, 1 file can not be opened, 2 wrong header,
+ *         3 unsupported version, 7 invalid dimensions
+ */
+int read_binary_matrix_header(const char* filename,
+		BinaryMatrixHeader& header) {
+	FILE* fin = fopen(filename, "rb");
+	if (fin == NULL)
+		return 1;
+	size_t read = fread(&header, sizeof(BinaryMatrixHeader), 1, fin);
+	fclose(fin);
+	if (read != 1
+			|| strncmp(header.magic, BINARY_MATRIX_MAGIC, sizeof(header.magic))
+					!= 0)
+		return 2;
+	if (header.version != BINARY_MATRIX_VERSION)
+		return 3;
+	if (!has_valid_dimensions(header))
+		return 7;
+	return 0;
+}
+
+/**
+ * Stores column-major matrix B (with leading dimension ldB) into binary file.
+ * Columns in file are padded to "alignment" bytes.
+ *
+ * @return 0 on success, 1 file can not be created, 2 write failed
+ */
+template<typename F>
+int write_binary_matrix_file(const char* filename, const F* B,
+		unsigned int ldB, unsigned int m, unsigned int n,
+		unsigned int alignment = BINARY_MATRIX_DEFAULT_ALIGNMENT) {
+	BinaryMatrixHeader header;
+	strncpy(header.magic, BINARY_MATRIX_MAGIC, sizeof(header.magic));
+	header.version = BINARY_MATRIX_VERSION;
+	header.precision = sizeof(F);
+	header.m = m;
+	header.n = n;
+	const unsigned long long elementsPerAlignment =
+			(alignment > sizeof(F)) ? alignment / sizeof(F) : 1;
+	header.ldB = ((m + elementsPerAlignment - 1) / elementsPerAlignment)
+			* elementsPerAlignment;
+	header.alignment = alignment;
+	header.dataOffset = BINARY_MATRIX_DATA_OFFSET;
+	FILE* fout = fopen(filename, "wb");
+	if (fout == NULL)
+		return 1;
+	std::vector<char> padding(header.dataOffset - sizeof(BinaryMatrixHeader),
+			0);
+	if (fwrite(&header, sizeof(BinaryMatrixHeader), 1, fout) != 1
+			|| fwrite(&padding[0], 1, padding.size(), fout)
+					!= padding.size()) {
+		fclose(fout);
+		return 2;
+	}
+	std::vector<F> column(header.ldB, 0);
+	for (unsigned int col = 0; col < n; col++) {
+		memcpy(&column[0], &B[(unsigned long long) col * ldB], m * sizeof(F));
+		if (fwrite(&column[0], sizeof(F), header.ldB, fout) != header.ldB) {
+			fclose(fout);
+			return 2;
+		}
+	}
+	if (fclose(fout) != 0)
+		return 2;
+	return 0;
+}
+
+/*
+ * Read-only memory mapping of a binary matrix file. Data are not copied,
+ * "data" points directly into the page cache.
+ */
+template<typename F>
+class MappedMatrix {
+public:
+	BinaryMatrixHeader header;
+	const F* data;
+	unsigned int m;
+	unsigned int n;
+	unsigned int ldB;
+
+	MappedMatrix() {
+		data = NULL;
+		m = 0;
+		n = 0;
+		ldB = 0;
+	}
+
+	/**
+	 * @return 0 on success, 1 file can not be opened, 2 wrong header,
+	 *         3 unsupported version, 4 precision mismatch, 5 mmap failed,
+	 *         6 file is truncated, 7 invalid dimensions
+	 */
+	int map(const char* filename) {
+		unmap();
+		int status = read_binary_matrix_header(filename, header);
+		if (status != 0)
+			return status;
+		if (header.precision != sizeof(F))
+			return 4;
+		// B is streamed as a whole in every iteration
+		status = file.map(filename, MADV_WILLNEED);
+		if (status != 0)
+			return status;
+		if (file.length
+				< header.dataOffset + header.ldB * header.n * header.precision) {
+			file.unmap();
+			return 6;
+		}
+		data = (const F*) (file.data + header.dataOffset);
+		m = header.m;
+		n = header.n;
+		ldB = header.ldB;
+		return 0;
+	}
+
+	void unmap() {
+		file.unmap();
+		data = NULL;
+	}
+
+private:
+	MappedFile file;
+	MappedMatrix(const MappedMatrix&);
+	MappedMatrix& operator=(const MappedMatrix&);
+};
+
+}
+#endif /* BINARY_MATRIX_FILE_H_ */
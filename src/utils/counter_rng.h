@@ -0,0 +1,102 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  Counter based random numbers (Philox4x32-10, J. Salmon et al.
+ *  "Parallel random numbers: as easy as 1, 2, 3"). Number "index" of stream
+ *  "stream" is a pure function of (seed, stream, index), so starting points do
+ *  not depend on number of threads, order of generation or batch layout.
+ *  Streams correspond to starting points, indices to coordinates.
+ *
+ */
+
+#ifndef COUNTER_RNG_H_
+#define COUNTER_RNG_H_
+
+#include <stdint.h>
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+// one block of 4 random words (c0, c1, c2, c3) for counter "block" of given stream
+inline void philox4x32(const uint32_t seed, const uint32_t stream,
+		const uint64_t block, uint32_t& c0, uint32_t& c1, uint32_t& c2,
+		uint32_t& c3) {
+	c0 = (uint32_t) block;
+	c1 = (uint32_t) (block >> 32);
+	c2 = stream;
+	c3 = 0;
+	uint32_t k0 = seed;
+	uint32_t k1 = 0;
+	for (int round = 0; round < PHILOX_ROUNDS; round++) {
+		const uint64_t p0 = (uint64_t) PHILOX_M0 * c0;
+		const uint64_t p1 = (uint64_t) PHILOX_M1 * c2;
+		const uint32_t n0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+		const uint32_t n2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+		c1 = (uint32_t) p1;
+		c3 = (uint32_t) p0;
+		c0 = n0;
+		c2 = n2;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+}
+
+// uniform number from [0,1), 24 bits are exactly representable also in float
+template<typename F>
+inline F counter_rng_to_uniform(const uint32_t word) {
+	return (F) ((word >> 8) * (1.0 / 16777216.0));
+}
+
+// number "index" of stream "stream", uniform from [0,1)
+template<typename F>
+inline F counter_rng_uniform(const unsigned int seed, const unsigned int stream,
+		const unsigned long long index) {
+	uint32_t out[4];
+	philox4x32(seed, stream, index / 4, out[0], out[1], out[2], out[3]);
+	return counter_rng_to_uniform<F>(out[index % 4]);
+}
+
+/*
+ * x[i] = a + (b - a) * U(seed, stream, offset + i) for i < length.
+ * Whole blocks are independent, the loop over them is vectorized.
+ */
+template<typename F>
+void counter_rng_fill_uniform(F* x, const unsigned long long length,
+		const F a, const F b, const unsigned int seed,
+		const unsigned int stream, const unsigned long long offset = 0) {
+	const F scale = b - a;
+	unsigned long long i = 0;
+	// head, until offset + i is a multiple of 4
+	for (; i < length && (offset + i) % 4 != 0; i++)
+		x[i] = a + scale * counter_rng_uniform<F>(seed, stream, offset + i);
+	const unsigned long long firstBlock = (offset + i) / 4;
+	const long long blocks = (length - i) / 4;
+	F* y = &x[i];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+	for (long long block = 0; block < blocks; block++) {
+		uint32_t c0, c1, c2, c3;
+		philox4x32(seed, stream, firstBlock + block, c0, c1, c2, c3);
+		y[4 * block] = a + scale * counter_rng_to_uniform<F>(c0);
+		y[4 * block + 1] = a + scale * counter_rng_to_uniform<F>(c1);
+		y[4 * block + 2] = a + scale * counter_rng_to_uniform<F>(c2);
+		y[4 * block + 3] = a + scale * counter_rng_to_uniform<F>(c3);
+	}
+	for (i += 4 * blocks; i < length; i++)
+		x[i] = a + scale * counter_rng_uniform<F>(seed, stream, offset + i);
+}
+
+#endif /* COUNTER_RNG_H_ */
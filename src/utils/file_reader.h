@@ -24,26 +24,280 @@
 #include <string.h>
 #include <iostream>
 #include <iomanip>
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "mapped_file.h"
 using namespace std;
 
 namespace InputOuputHelper {
 
-void parse_data_size_from_CSV_file(unsigned int &m, unsigned int &n,
-		const char* input_csv_file) {
-	m = 0;
-	n = 0;
-	std::ifstream data(input_csv_file);
-	std::string line;
-	while (std::getline(data, line)) {
-		if (m == 0) {
-			std::stringstream lineStream(line);
-			std::string cell;
-			while (std::getline(lineStream, cell, ',')) {
-				n++;
+/*
+ * CSV parsing works directly on the memory mapped file. The file is split into
+ * chunks at newline boundaries; every OpenMP thread counts rows of its chunks
+ * and afterwards parses them straight into the column-major matrix, so the
+ * file is read from disk only once.
+ */
+
+#define CSV_CHUNKS_PER_THREAD 4
+#define CSV_MAX_TOKEN_LENGTH 64
+
+const double CSV_POWERS_OF_TEN[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+		1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+		1e20, 1e21, 1e22 };
+
+inline bool is_CSV_space(const char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+/*
+ * Parses one number starting at "p" and moves "p" behind it. Numbers with at
+ * most 19 significant digits and a decimal exponent up to 22 are converted
+ * exactly (mantissa and power of ten are both exact doubles), everything else
+ * (long mantissas, "nan", "inf", ...) falls back to strtod. "valid" is set to
+ * false if the field is not a number (e.g. empty or "1.5abc").
+ */
+inline double parse_CSV_number(const char*& p, const char* end, bool& valid) {
+	const char* begin = p;
+	bool anyDigit = false;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		p++;
+	}
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	while (p < end && *p >= '0' && *p <= '9') {
+		anyDigit = true;
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa > 0)
+				digits++;
+		} else {
+			exponent++;
+			digits++;
+		}
+		p++;
+	}
+	if (p < end && *p == '.') {
+		p++;
+		while (p < end && *p >= '0' && *p <= '9') {
+			anyDigit = true;
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa > 0)
+					digits++;
+				exponent--;
+			} else {
+				digits++;
+			}
+			p++;
+		}
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negativeExponent = (*p == '-');
+			p++;
+		}
+		int e = 0;
+		while (p < end && *p >= '0' && *p <= '9') {
+			if (e < 100000)
+				e = e * 10 + (*p - '0');
+			p++;
+		}
+		exponent += negativeExponent ? -e : e;
+	}
+	if (!anyDigit || digits > 19 || mantissa >= (1ULL << 53) || exponent > 22
+			|| exponent < -22
+			|| (p < end && *p != ',' && *p != '\n' && !is_CSV_space(*p))) {
+		// slow path, strtod needs null terminated string
+		char token[CSV_MAX_TOKEN_LENGTH + 1];
+		int length = 0;
+		p = begin;
+		while (p < end && *p != ',' && *p != '\n' && length < CSV_MAX_TOKEN_LENGTH)
+			token[length++] = *p++;
+		token[length] = 0;
+		char* tokenEnd;
+		const double value = strtod(token, &tokenEnd);
+		valid = (tokenEnd != token);
+		while (is_CSV_space(*tokenEnd))
+			tokenEnd++;
+		// whole token is the number and it was not cut at maximal length
+		valid = valid && *tokenEnd == 0
+				&& (p == end || *p == ',' || *p == '\n');
+		return value;
+	}
+	valid = true;
+	double value = (double) mantissa;
+	if (exponent < 0)
+		value /= CSV_POWERS_OF_TEN[-exponent];
+	else
+		value *= CSV_POWERS_OF_TEN[exponent];
+	return negative ? -value : value;
+}
+
+// returns true if line [begin,end) contains something else than white spaces
+inline bool is_CSV_row(const char* begin, const char* end) {
+	for (const char* p = begin; p < end; p++)
+		if (!is_CSV_space(*p))
+			return true;
+	return false;
+}
+
+inline const char* find_line_end(const char* p, const char* end) {
+	const char* newline = (const char*) memchr(p, '\n', end - p);
+	return newline == NULL ? end : newline;
+}
+
+/*
+ * Splits [0,length) into chunks which start at the beginning of a line.
+ * chunkStarts has chunks+1 entries, the last one is "length".
+ */
+void split_CSV_buffer_into_chunks(const char* buffer, const size_t length,
+		std::vector<size_t>& chunkStarts) {
+	int chunks = 1;
+#ifdef _OPENMP
+	chunks = omp_get_max_threads() * CSV_CHUNKS_PER_THREAD;
+#endif
+	chunkStarts.resize(chunks + 1);
+	chunkStarts[0] = 0;
+	for (int chunk = 1; chunk < chunks; chunk++) {
+		size_t position = (length / chunks) * chunk;
+		if (position < chunkStarts[chunk - 1])
+			position = chunkStarts[chunk - 1];
+		// move to the first character of the next line
+		while (position > 0 && position < length && buffer[position - 1] != '\n')
+			position++;
+		chunkStarts[chunk] = position;
+	}
+	chunkStarts[chunks] = length;
+}
+
+// counts rows in every chunk
+void count_CSV_rows_in_chunks(const char* buffer,
+		const std::vector<size_t>& chunkStarts, std::vector<size_t>& rowsInChunk) {
+	const int chunks = chunkStarts.size() - 1;
+	rowsInChunk.resize(chunks);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (int chunk = 0; chunk < chunks; chunk++) {
+		const char* p = buffer + chunkStarts[chunk];
+		const char* end = buffer + chunkStarts[chunk + 1];
+		size_t rows = 0;
+		while (p < end) {
+			const char* lineEnd = find_line_end(p, end);
+			if (is_CSV_row(p, lineEnd))
+				rows++;
+			p = lineEnd + 1;
+		}
+		rowsInChunk[chunk] = rows;
+	}
+}
+
+// number of columns is given by the first row
+unsigned int count_CSV_columns(const char* buffer, const size_t length) {
+	const char* p = buffer;
+	const char* end = buffer + length;
+	while (p < end) {
+		const char* lineEnd = find_line_end(p, end);
+		if (is_CSV_row(p, lineEnd)) {
+			unsigned int n = 1;
+			for (; p < lineEnd; p++)
+				if (*p == ',')
+					n++;
+			return n;
+		}
+		p = lineEnd + 1;
+	}
+	return 0;
+}
+
+/*
+ * Parses all rows of the mapped CSV file into column-major "data" (m x n).
+ * Returns 0 on success and 2 if some row has not exactly n comma separated
+ * numbers (missing or extra values, a field which is not a number).
+ */
+template<typename D>
+int parse_CSV_chunks(const char* buffer, const std::vector<size_t>& chunkStarts,
+		const std::vector<size_t>& rowsInChunk, const unsigned int m,
+		const unsigned int n, std::vector<D>& data) {
+	const int chunks = chunkStarts.size() - 1;
+	std::vector<size_t> firstRowOfChunk(chunks + 1, 0);
+	for (int chunk = 0; chunk < chunks; chunk++)
+		firstRowOfChunk[chunk + 1] = firstRowOfChunk[chunk] + rowsInChunk[chunk];
+	data.resize((size_t) n * m);
+	std::vector<int> chunkError(chunks, 0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (int chunk = 0; chunk < chunks; chunk++) {
+		const char* p = buffer + chunkStarts[chunk];
+		const char* end = buffer + chunkStarts[chunk + 1];
+		size_t row = firstRowOfChunk[chunk];
+		while (p < end && row < m && !chunkError[chunk]) {
+			const char* lineEnd = find_line_end(p, end);
+			if (is_CSV_row(p, lineEnd)) {
+				unsigned int col = 0;
+				bool valid = true;
+				for (;;) {
+					while (p < lineEnd && is_CSV_space(*p))
+						p++;
+					valid = false;
+					if (col < n)
+						data[row + (size_t) col * m] = parse_CSV_number(p,
+								lineEnd, valid);
+					if (!valid)
+						break;
+					col++;
+					while (p < lineEnd && is_CSV_space(*p))
+						p++;
+					if (p == lineEnd)
+						break;
+					valid = (*p == ',');
+					if (!valid)
+						break;
+					p++;
+				}
+				if (!valid || col != n)
+					chunkError[chunk] = 1;
+				row++;
 			}
+			p = lineEnd + 1;
 		}
-		m++;
 	}
+	for (int chunk = 0; chunk < chunks; chunk++)
+		if (chunkError[chunk])
+			return 2;
+	return 0;
+}
+
+/**
+ * Parses data size from file
+ *
+ * @param m - number of rows of matrix stored in CSV file
+ * @param n - number of columns of matrix stored in CSV file
+ * @param filename - filename of file to be read from
+ */
+int parse_data_size_from_CSV_file(unsigned int &m, unsigned int &n,
+		const char* input_csv_file) {
+	m = 0;
+	n = 0;
+	MappedFile file;
+	if (file.map(input_csv_file) != 0)
+		return 1;
+	std::vector<size_t> chunkStarts;
+	std::vector<size_t> rowsInChunk;
+	split_CSV_buffer_into_chunks(file.data, file.length, chunkStarts);
+	count_CSV_rows_in_chunks(file.data, chunkStarts, rowsInChunk);
+	for (unsigned int chunk = 0; chunk < rowsInChunk.size(); chunk++)
+		m += rowsInChunk[chunk];
+	n = count_CSV_columns(file.data, file.length);
+	return 0;
 }
 
 /**
@@ -52,37 +306,46 @@ void parse_data_size_from_CSV_file(unsigned int &m, unsigned int &n,
  * @param m - number of rows of matrix stored in CSV file
  * @param n - number of columns of matrix stored in CSV file
  * @param filename - filename of file to be read from
+ * @return 0 on success, 1 if the file cannot be read, 2 if it is malformed
  */
 template<typename D>
 int parse_data_from_CSV_file(unsigned int m, unsigned int n,
 		const char* input_csv_file, std::vector<D> & data) {
-	data.resize(n * m);
-	ifstream my_read_file;
-	my_read_file.open(input_csv_file);
-	D value;
-	if (my_read_file.is_open()) {
-		for (unsigned int row = 0; row < m; row++) {
-			for (unsigned int col = 0; col < n; col++) {
-				my_read_file >> value;
-				char c;
-				if (col < n - 1)
-					my_read_file >> c;
-				data[row + col * m] = value;
-			}
-		}
-		my_read_file.close();
-		return 0;
-	} else {
+	MappedFile file;
+	if (file.map(input_csv_file) != 0)
 		return 1;
-	}
+	std::vector<size_t> chunkStarts;
+	std::vector<size_t> rowsInChunk;
+	split_CSV_buffer_into_chunks(file.data, file.length, chunkStarts);
+	count_CSV_rows_in_chunks(file.data, chunkStarts, rowsInChunk);
+	return parse_CSV_chunks(file.data, chunkStarts, rowsInChunk, m, n, data);
 }
 
+/*
+ * Reads size and data with a single mapping of the file. Returns 0 on
+ * success, 1 if the file cannot be read or holds no data, 2 if it is
+ * malformed (see parse_CSV_chunks).
+ */
 template<typename F>
-void readCSVFile(std::vector<F> &Bmat, unsigned int &ldB, unsigned int &m,
+int readCSVFile(std::vector<F> &Bmat, unsigned int &ldB, unsigned int &m,
 		unsigned int & n, const char* input_csv_file) {
-	parse_data_size_from_CSV_file(m, n, input_csv_file);
-	parse_data_from_CSV_file(m, n, input_csv_file, Bmat);
+	m = 0;
+	n = 0;
+	ldB = 0;
+	MappedFile file;
+	if (file.map(input_csv_file) != 0)
+		return 1;
+	std::vector<size_t> chunkStarts;
+	std::vector<size_t> rowsInChunk;
+	split_CSV_buffer_into_chunks(file.data, file.length, chunkStarts);
+	count_CSV_rows_in_chunks(file.data, chunkStarts, rowsInChunk);
+	for (unsigned int chunk = 0; chunk < rowsInChunk.size(); chunk++)
+		m += rowsInChunk[chunk];
+	n = count_CSV_columns(file.data, file.length);
+	if (m == 0 || n == 0)
+		return 1;
 	ldB = m;
+	return parse_CSV_chunks(file.data, chunkStarts, rowsInChunk, m, n, Bmat);
 }
 
 char* get_file_modified_name(const char* base, string suffix) {
@@ -113,6 +376,7 @@ void saveSolverStatistics(SolverStructures::OptimizationStatistics* optimization
 		statFile << "Batch size: " << optimizationSettings->batchSize<< '\n';
 		statFile << "Batching strategy (OTF): " << optimizationSettings->useOTF<< '\n';
 		statFile << "Double precision: " << optimizationSettings->useDoublePrecision<< '\n';
+		statFile << "Storage precision (0 full, 1 bfloat16, 2 fp16): " << optimizationSettings->storagePrecision<< '\n';
 		statFile << "tolerance: " << optimizationSettings->tolerance<< '\n';
 	#ifdef DEBUG
 		statFile << "DEBUG MODE: " << 1<< '\n';
@@ -125,6 +389,13 @@ void saveSolverStatistics(SolverStructures::OptimizationStatistics* optimization
 		statFile << '\n'<< "Result " << '\n';
 		statFile << "Objective value: " << setprecision(16)<< optimizationStatistics->fval<< '\n';
 		statFile << "Elapsed it (total): " << optimizationStatistics->it<< '\n';
+		if (optimizationStatistics->fullPrecisionValue >= 0) {
+			// accuracy of reduced precision storage of B
+			statFile << "Objective value on full precision data: " << setprecision(16)<< optimizationStatistics->fullPrecisionValue<< '\n';
+			statFile << "Relative difference: " << setprecision(16)
+					<< (optimizationStatistics->fval - optimizationStatistics->fullPrecisionValue)
+							/ optimizationStatistics->fullPrecisionValue << '\n';
+		}
 		statFile << "Average it (per starting point): "<< setprecision(16) << optimizationStatistics->it*optimizationSettings->batchSize/(0.0+optimizationSettings->totalStartingPoints)<< '\n';
 
 
@@ -0,0 +1,86 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  Read-only memory mapping of a whole file
+ *
+ */
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace InputOuputHelper {
+
+class MappedFile {
+public:
+	const char* data;
+	size_t length;
+
+	MappedFile() {
+		data = NULL;
+		length = 0;
+	}
+
+	~MappedFile() {
+		unmap();
+	}
+
+	/**
+	 * @param advice - madvise hint (MADV_SEQUENTIAL, MADV_WILLNEED, ...)
+	 * @return 0 on success, 1 file can not be opened, 5 mmap failed
+	 */
+	int map(const char* filename, int advice = MADV_SEQUENTIAL) {
+		unmap();
+		int fd = open(filename, O_RDONLY);
+		if (fd < 0)
+			return 1;
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0) {
+			close(fd);
+			return 1;
+		}
+		length = fileStat.st_size;
+		if (length == 0) {
+			close(fd);
+			return 0;
+		}
+		void* mapping = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (mapping == MAP_FAILED) {
+			length = 0;
+			return 5;
+		}
+		madvise(mapping, length, advice);
+		data = (const char*) mapping;
+		return 0;
+	}
+
+	void unmap() {
+		if (data != NULL) {
+			munmap((void*) data, length);
+			data = NULL;
+		}
+		length = 0;
+	}
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
+
+}
+#endif /* MAPPED_FILE_H_ */
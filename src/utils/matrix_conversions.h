@@ -117,6 +117,32 @@ void getCSR_from_CSC(
 	Z_csr_RowPtr[0] = 0;
 }
 
+// the same as above, but works on raw CSC arrays (nnz = Z_csc_col_ptr[n])
+template<typename T, typename I>
+void getCSR_from_CSC(const T* Z_csc_values, const I* Z_csc_row_idx,
+		const I* Z_csc_col_ptr, std::vector<T>& Z_csr_val,
+		std::vector<I>& Z_csr_colIdx, std::vector<I>& Z_csr_RowPtr, int m,
+		int n) {
+	const I nnz = Z_csc_col_ptr[n];
+	Z_csr_val.resize(nnz);
+	Z_csr_colIdx.resize(nnz);
+	Z_csr_RowPtr.assign(m + 1, 0);
+	for (I i = 0; i < nnz; i++) {
+		Z_csr_RowPtr[Z_csc_row_idx[i] + 1]++;
+	}
+	for (int i = 0; i < m; i++) {
+		Z_csr_RowPtr[i + 1] += Z_csr_RowPtr[i];
+	}
+	std::vector<I> position(Z_csr_RowPtr.begin(), Z_csr_RowPtr.end() - 1);
+	for (int col = 0; col < n; col++) {
+		for (I tmp = Z_csc_col_ptr[col]; tmp < Z_csc_col_ptr[col + 1]; tmp++) {
+			const I dst = position[Z_csc_row_idx[tmp]]++;
+			Z_csr_val[dst] = Z_csc_values[tmp];
+			Z_csr_colIdx[dst] = col;
+		}
+	}
+}
+
 template<typename T, typename I>
 void getCSC_from_CSR(
 		std::vector<T>& Z_csr_val, //Input
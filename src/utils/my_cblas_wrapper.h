@@ -85,6 +85,21 @@ void cblas_matrix_matrix_multiply(const CBLAS_ORDER Order,
 			ldc);
 }
 
+// C = alpha * A'A + beta * C (Trans) or alpha * AA' + beta * C, only "Uplo" triangle of C
+void cblas_symmetric_rank_k_update(const CBLAS_ORDER Order,
+		const CBLAS_UPLO Uplo, const CBLAS_TRANSPOSE Trans, const int N,
+		const int K, const double alpha, const double *A, const int lda,
+		const double beta, double *C, const int ldc) {
+	cblas_dsyrk(Order, Uplo, Trans, N, K, alpha, A, lda, beta, C, ldc);
+}
+
+void cblas_symmetric_rank_k_update(const CBLAS_ORDER Order,
+		const CBLAS_UPLO Uplo, const CBLAS_TRANSPOSE Trans, const int N,
+		const int K, const float alpha, const float *A, const int lda,
+		const float beta, float *C, const int ldc) {
+	cblas_ssyrk(Order, Uplo, Trans, N, K, alpha, A, lda, beta, C, ldc);
+}
+
 double cblas_l1_norm(const int N, const double *X, const int incX) {
 	return cblas_dasum(N, X, incX);
 }
@@ -112,6 +127,26 @@ void cblas_vector_copy(const int N, const float *X, const int incX,
 }
 
 
+double cblas_vector_dot(const int N, const double *X, const int incX,
+		const double *Y, const int incY) {
+	return cblas_ddot(N, X, incX, Y, incY);
+}
+
+float cblas_vector_dot(const int N, const float *X, const int incX,
+		const float *Y, const int incY) {
+	return cblas_sdot(N, X, incX, Y, incY);
+}
+
+// Y = alpha * X + Y
+void cblas_vector_add(const int N, const double alpha, const double *X,
+		const int incX, double *Y, const int incY) {
+	cblas_daxpy(N, alpha, X, incX, Y, incY);
+}
+
+void cblas_vector_add(const int N, const float alpha, const float *X,
+		const int incX, float *Y, const int incY) {
+	cblas_saxpy(N, alpha, X, incX, Y, incY);
+}
 
 CBLAS_INDEX cblas_vector_max_index(const int N, const double *X, const int incX){
 	return cblas_idamax(N, X, incX);
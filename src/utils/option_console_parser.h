@@ -22,6 +22,7 @@
 #ifndef OPTION_PARSER_H_
 #define OPTION_PARSER_H_
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -50,19 +51,39 @@ int parseConsoleOptions(SolverStructures::OptimizationSettings* optimizationSett
 	 * i - max number of iterations (*optional*)
 	 * t - tolerance (*optional*)
 	 * s - number of starting points (*optional*)
-	 * b - batch sizes (*optional*)
 	 * u - batching type (*optional*)
+	 * a - active-set iterations for constrained formulations (*optional*)
 	 * v - verbose (*optional*) default false
-	 * p - use DOUBLE precission (*optional*)
-	 * a - algorithm
+	 * p - starting points: 0 random, 1 largest columns, 2 combinations of
+	 *     largest columns, 3 sketch of leading singular subspace (*optional*)
+	 * c - Gram matrix B'B for L2 formulations: 0 automatic, 1 never, 2 always
+	 *     (*optional*)
+	 * h - storage of B: 0 float/double, 1 bfloat16, 2 fp16; computation
+	 *     stays in float/double, the solution of a binary file is evaluated
+	 *     also on full precision B; not with "w" (*optional*)
+	 * b - L1 formulations: 1 keeps z only as bit-packed signs of one row
+	 *     panel and computes B'*sgn(z) from them, 0 by GEMM (default 0)
+	 *     (*optional*)
+	 * e - out-of-core mode for binary files: B is read from disk in row
+	 *     panels of given size in MB (two panels are in memory); not with
+	 *     "w" or "h", a warning is printed if it is ignored (*optional*)
+	 * k - threading of the per-column work: 0 automatic, 1 across starting
+	 *     points, 2 within a vector (*optional*)
+	 * f - formulation
 	 * n - constrain parameter
 	 * m - penaltyParameter parameter
+	 * w - regularization path: comma separated values of constraint (integers
+	 *     >= 1) or penalty (> 0) parameter, solved in given order with warm
+	 *     starts (*optional*)
+	 * j - path mode: 1 solves all values of "w" jointly, their starting points
+	 *     share batches (*optional*)
 	 * x - x-dimension of distributed files (FOR DISTRIBUTED METHOD ONLY)
 	 */
 	bool inputFilePath = false;
 	bool outputFilePath = false;
 	bool algorithm = false;
-	while ((c = getopt(argc, argv, "i:f:o:m:t:l:r:u:v:d:s:g:x:")) != -1) {
+	bool pathValues = true;
+	while ((c = getopt(argc, argv, "i:f:o:m:t:l:r:u:a:p:v:d:s:g:x:w:j:c:h:e:b:k:")) != -1) {
 		switch (c) {
 		case 'x':
 			optimizationSettings->distributedRowGridFile = atoi(optarg);
@@ -93,6 +114,55 @@ int parseConsoleOptions(SolverStructures::OptimizationSettings* optimizationSett
 		case 'u':
 			optimizationSettings->useOTF= atoi(optarg);
 			break;
+		case 'a':
+			optimizationSettings->useActiveSet = atoi(optarg);
+			break;
+		case 'w': {
+			optimizationSettings->pathParameters.clear();
+			char* next = optarg;
+			pathValues = true;
+			while (true) {
+				char* end;
+				double value = strtod(next, &end);
+				if (end == next || (*end != ',' && *end != '\0')) {
+					pathValues = false;
+					break;
+				}
+				optimizationSettings->pathParameters.push_back(value);
+				if (*end == '\0')
+					break;
+				next = end + 1;
+			}
+			if (!pathValues)
+				optimizationSettings->pathParameters.clear();
+			break;
+		}
+		case '?':
+			if (optopt == 'w')
+				pathValues = false;
+			break;
+		case 'h':
+			optimizationSettings->storagePrecision = (StoragePrecision) atoi(optarg);
+			break;
+		case 'b':
+			optimizationSettings->useSignBitKernel = atoi(optarg);
+			break;
+		case 'e':
+			optimizationSettings->outOfCorePanelMegabytes = atoi(optarg);
+			break;
+		case 'c':
+			optimizationSettings->gramMatrixMode = (GramMatrixMode) atoi(optarg);
+			break;
+		case 'k':
+			optimizationSettings->threadingMode = (ThreadingMode) atoi(optarg);
+			break;
+		case 'j':
+			optimizationSettings->batchPathParameters = atoi(optarg);
+			break;
+		case 'p':
+			optimizationSettings->startingPointStrategy =
+					(StartingPointStrategy) atoi(optarg);
+			break;
 		case 't':
 			optimizationSettings->tolerance = atof(optarg);
 			break;
@@ -148,6 +218,34 @@ int parseConsoleOptions(SolverStructures::OptimizationSettings* optimizationSett
 			print_usage();
 		return 1;
 	}
+	// "w" needs cardinalities (integers >= 1) or penalties > 0
+	for (unsigned int i = 0; i < optimizationSettings->pathParameters.size(); i++) {
+		const double value = optimizationSettings->pathParameters[i];
+		if (optimizationSettings->isConstrainedProblem() ?
+				(value < 1 || value != floor(value)) : !(value > 0))
+			pathValues = false;
+	}
+	if (!pathValues) {
+		if (optimizationSettings->proccessNode == 0) {
+			cout << "Values of \"-w\" have to be comma separated "
+					<< (optimizationSettings->isConstrainedProblem() ?
+							"integers >= 1" : "numbers > 0") << endl;
+			print_usage();
+		}
+		return 1;
+	}
+	if (!optimizationSettings->pathParameters.empty()
+			&& optimizationSettings->storagePrecision != FullPrecisionStorage) {
+		if (optimizationSettings->proccessNode == 0)
+			cout << "Reduced precision storage \"-h\" is not supported with \"-w\"" << endl;
+		return 1;
+	}
+	if (optimizationSettings->isConstrainedProblem()
+			&& optimizationSettings->constraintParameter == 0) {
+		if (optimizationSettings->proccessNode == 0)
+			cout << "Cardinality \"-s\" has to be at least 1" << endl;
+		return 1;
+	}
 
 	if (optimizationSettings->batchSize > optimizationSettings->totalStartingPoints) {
 		optimizationSettings->totalStartingPoints = optimizationSettings->batchSize;
@@ -0,0 +1,85 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  16-bit floating point formats used to store data matrix B:
+ *  bfloat16 (8 bits of exponent as float, 7 bits of mantissa) and IEEE half
+ *  precision fp16 (5 bits of exponent, 10 bits of mantissa, max 65504).
+ *  Encoding rounds to nearest even, decoding is exact and branch free, so
+ *  loops over columns are vectorized.
+ *
+ */
+
+#ifndef REDUCED_PRECISION_H_
+#define REDUCED_PRECISION_H_
+
+#include <stdint.h>
+#include <string.h>
+
+inline uint32_t float_as_bits(const float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+inline float bits_as_float(const uint32_t bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+inline uint16_t float_to_bfloat16(const float value) {
+	const uint32_t bits = float_as_bits(value);
+	if ((bits & 0x7FFFFFFFu) > 0x7F800000u) // NaN stays (quiet) NaN
+		return (uint16_t) ((bits >> 16) | 0x0040u);
+	return (uint16_t) ((bits + 0x7FFFu + ((bits >> 16) & 1)) >> 16);
+}
+
+inline float bfloat16_to_float(const uint16_t value) {
+	return bits_as_float((uint32_t) value << 16);
+}
+
+/*
+ * IEEE half precision, round to nearest even; values above 65504 become
+ * infinity, small values become subnormal numbers or zero
+ */
+inline uint16_t float_to_float16(const float value) {
+	uint32_t bits = float_as_bits(value);
+	const uint16_t sign = (uint16_t) ((bits >> 16) & 0x8000u);
+	bits &= 0x7FFFFFFFu;
+	uint16_t result;
+	if (bits >= 0x47800000u) { // 65536 and more, Inf or NaN
+		result = (bits > 0x7F800000u) ? 0x7E00u : 0x7C00u;
+	} else if (bits < 0x38800000u) { // subnormal half (or zero)
+		// adding 0.5 aligns mantissa such that float rounding does the work
+		const float aligned = bits_as_float(bits) + 0.5f;
+		result = (uint16_t) (float_as_bits(aligned) - 0x3F000000u);
+	} else {
+		const uint32_t odd = (bits >> 13) & 1;
+		bits += ((uint32_t) (15 - 127) << 23) + 0xFFFu + odd;
+		result = (uint16_t) (bits >> 13);
+	}
+	return result | sign;
+}
+
+/*
+ * Exponent is rebiased by multiplication by 2^112, which is exact also for
+ * subnormal halfs; no branches, so loops are vectorized
+ */
+inline float float16_to_float(const uint16_t value) {
+	const uint32_t magnitude = ((uint32_t) value & 0x7FFFu) << 13;
+	uint32_t bits = float_as_bits(
+			bits_as_float(magnitude) * bits_as_float(0x77800000u));
+	bits |= ((value & 0x7C00u) == 0x7C00u) ? 0x7F800000u : 0; // Inf or NaN
+	return bits_as_float(bits | (((uint32_t) value & 0x8000u) << 16));
+}
+
+#endif /* REDUCED_PRECISION_H_ */
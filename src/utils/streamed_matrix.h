@@ -0,0 +1,212 @@
+/*
+ *
+ * This is a parallel sparse PCA solver
+ *
+ * The solver is based on a simple alternating maximization (AM) subroutine
+ * and is based on the paper
+ *    P. Richtarik, M. Takac and S. Damla Ahipasaoglu
+ *    "Alternating Maximization: Unifying Framework for 8 Sparse PCA Formulations and Efficient Parallel Codes"
+ *
+ * The code is available at https://code.google.com/p/24am/
+ * under GNU GPL v3 License
+ *
+ *  Out-of-core access to a binary matrix file (see binary_matrix_file.h).
+ *  B is read in panels of consecutive rows (all n columns, one contiguous
+ *  segment per column). Two panel buffers are kept: while the solver works
+ *  on one of them, a background thread reads the next panel (after the last
+ *  panel it reads panel 0 for the next pass) into the other one. If the
+ *  whole matrix fits into one panel, it is read only once.
+ *
+ */
+
+#ifndef STREAMED_MATRIX_H_
+#define STREAMED_MATRIX_H_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "binary_matrix_file.h"
+#include "timer.h"
+
+namespace InputOuputHelper {
+
+// memory of one panel buffer (two are allocated)
+#define STREAMED_MATRIX_DEFAULT_PANEL_BYTES (256ull << 20)
+
+template<typename F>
+class StreamedMatrix {
+public:
+	BinaryMatrixHeader header;
+	unsigned int m;
+	unsigned int n;
+	unsigned int panelRows; // rows of a panel (the last one can be shorter)
+	unsigned int panels;
+	mutable unsigned long long bytesRead; // statistics of all reads
+	mutable double waitTime; // time spent waiting for data in panel()
+
+	StreamedMatrix() {
+		fd = -1;
+		m = 0;
+		n = 0;
+		panelRows = 0;
+		panels = 0;
+		bytesRead = 0;
+		waitTime = 0;
+		readFailed = false;
+		reading = false;
+		current = 0;
+		loadedPanel = -1;
+		prefetchedPanel = -1;
+	}
+
+	~StreamedMatrix() {
+		close();
+	}
+
+	/**
+	 * @param panelBytes - memory of one panel, two panels are allocated
+	 * @return 0 on success, 1 file can not be opened, 2 wrong header,
+	 *         3 unsupported version, 4 precision mismatch, 6 file is truncated,
+	 *         7 invalid dimensions
+	 */
+	int open(const char* filename, unsigned long long panelBytes =
+			STREAMED_MATRIX_DEFAULT_PANEL_BYTES) {
+		close();
+		int status = read_binary_matrix_header(filename, header);
+		if (status != 0)
+			return status;
+		if (header.precision != sizeof(F))
+			return 4;
+		fd = ::open(filename, O_RDONLY);
+		if (fd < 0)
+			return 1;
+		const off_t length = lseek(fd, 0, SEEK_END);
+		if ((unsigned long long) length
+				< header.dataOffset + header.ldB * header.n * header.precision) {
+			close();
+			return 6;
+		}
+		m = header.m;
+		n = header.n;
+		const unsigned long long rows = panelBytes
+				/ ((unsigned long long) std::max(n, 1u) * sizeof(F));
+		panelRows = (unsigned int) std::max(1ull,
+				std::min(rows, (unsigned long long) m));
+		panels = (m + panelRows - 1) / panelRows;
+		buffers[0].resize((size_t) panelRows * n);
+		if (panels > 1)
+			buffers[1].resize((size_t) panelRows * n);
+		return 0;
+	}
+
+	void close() {
+		wait_for_prefetch();
+		if (fd >= 0)
+			::close(fd);
+		fd = -1;
+		buffers[0].clear();
+		buffers[1].clear();
+		loadedPanel = -1;
+		prefetchedPanel = -1;
+	}
+
+	unsigned int rowsOfPanel(const unsigned int p) const {
+		return std::min(panelRows, m - p * panelRows);
+	}
+
+	/*
+	 * Rows [p * panelRows, p * panelRows + rowsOfPanel(p)) of B, column-major
+	 * with leading dimension rowsOfPanel(p). Waits for the prefetch of panel p
+	 * (or reads it) and starts the prefetch of the following one. Returned
+	 * data are valid until the next call.
+	 */
+	const F* panel(const unsigned int p) const {
+		if (loadedPanel == (int) p && panels == 1)
+			return &buffers[current][0];
+		double start = gettime();
+		wait_for_prefetch();
+		if (prefetchedPanel == (int) p) {
+			current = 1 - current;
+		} else {
+			read_panel(p, &buffers[current][0]);
+		}
+		prefetchedPanel = -1;
+		loadedPanel = p;
+		waitTime += gettime() - start;
+		if (panels > 1) {
+			prefetchedPanel = (p + 1) % panels;
+			reading = (pthread_create(&reader, NULL, prefetch_panel,
+					(void*) this) == 0);
+			if (!reading)
+				prefetchedPanel = -1;
+		}
+		return &buffers[current][0];
+	}
+
+	// rows [row, row + rows) of column j into "out"; can be called in parallel
+	bool readColumn(const unsigned int j, const unsigned int row,
+			const unsigned int rows, F* out) const {
+		char* data = (char*) out;
+		size_t remaining = (size_t) rows * sizeof(F);
+		off_t offset = header.dataOffset
+				+ ((off_t) header.ldB * j + row) * sizeof(F);
+		while (remaining > 0) {
+			ssize_t done = pread(fd, data, remaining, offset);
+			if (done < 0 && errno == EINTR)
+				continue;
+			if (done <= 0) {
+				readFailed = true;
+				std::fill((char*) data, data + remaining, 0);
+				return false;
+			}
+			data += done;
+			remaining -= done;
+			offset += done;
+		}
+		__sync_fetch_and_add(&bytesRead, (unsigned long long) rows * sizeof(F));
+		return true;
+	}
+
+	// 0 if all data were read, 7 on a read error (missing data are zeros)
+	int status() const {
+		return readFailed ? 7 : 0;
+	}
+
+private:
+	int fd;
+	mutable std::vector<F> buffers[2];
+	mutable int current; // buffer of the loaded panel
+	mutable int loadedPanel;
+	mutable int prefetchedPanel; // panel being read into the other buffer
+	mutable bool reading;
+	mutable pthread_t reader;
+	mutable bool readFailed;
+
+	void read_panel(const unsigned int p, F* out) const {
+		const unsigned int rows = rowsOfPanel(p);
+		for (unsigned int j = 0; j < n; j++)
+			readColumn(j, p * panelRows, rows, &out[(size_t) rows * j]);
+	}
+
+	static void* prefetch_panel(void* matrix) {
+		const StreamedMatrix<F>* self = (const StreamedMatrix<F>*) matrix;
+		self->read_panel(self->prefetchedPanel,
+				&self->buffers[1 - self->current][0]);
+		return NULL;
+	}
+
+	void wait_for_prefetch() const {
+		if (reading)
+			pthread_join(reader, NULL);
+		reading = false;
+	}
+
+	StreamedMatrix(const StreamedMatrix&);
+	StreamedMatrix& operator=(const StreamedMatrix&);
+};
+
+}
+#endif /* STREAMED_MATRIX_H_ */
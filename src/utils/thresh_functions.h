@@ -23,6 +23,7 @@
 #define TRESH_FUNCTIONS_H_
 
 #include "../class/optimization_settings.h"
+#include "../class/execution_policy.h"
 #include "termination_criteria.h"
 #include "my_cblas_wrapper.h"
 #include <math.h>
@@ -34,46 +35,76 @@
 #include <algorithm>
 
 using namespace std;
-#include <map>
-#include <list>
-#include <set>
 
 template<typename F>
-class data_for_sorted_map {
-public:
-	F value;
-	unsigned int idx;
-	data_for_sorted_map(F _value, unsigned int _idx) {
-		idx = _idx;
-		value = _value;
-	}
-
-};
+bool abs_value_comparator(const F & i, const F &j) {
+	return (myabs(i) < myabs(j));
+}
 
+/*
+ * Passes over one column. Called within loops over columns, so they do not
+ * open a parallel region unless "threads" > 1 (see execution_policy.h); then
+ * the column is split into "threads" chunks.
+ */
 template<typename F>
-class data_for_sorted_map_comp {
-public:
-	bool operator()(const data_for_sorted_map<F>& lhs,
-			const data_for_sorted_map<F>& rhs) const {
-		return lhs.value > rhs.value;
+void vector_sgn(F * y, unsigned int n) { // compute y=sgn(y)
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+	for (unsigned int i = 0; i < n; i++) {
+		y[i] = (F) ((y[i] > 0) - (y[i] < 0));
 	}
-};
-
-
+}
 
+/*
+ * y = sgn(y), returns \|y\|_1 of the original y; one pass instead of a norm
+ * and a sign pass
+ */
 template<typename F>
-bool abs_value_comparator(const F & i, const F &j) {
-	return (myabs(i) < myabs(j));
+F vector_l1_norm_and_sgn(F * y, const unsigned int n,
+		const unsigned int threads = 1) {
+	F norm = 0;
+	if (threads > 1) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) reduction(+:norm)
+#endif
+		for (unsigned int t = 0; t < threads; t++) {
+			const unsigned int begin = SolverStructures::vector_chunk(n,
+					threads, t);
+			norm += vector_l1_norm_and_sgn(&y[begin],
+					SolverStructures::vector_chunk(n, threads, t + 1) - begin);
+		}
+		return norm;
+	}
+#ifdef _OPENMP
+#pragma omp simd reduction(+:norm)
+#endif
+	for (unsigned int i = 0; i < n; i++) {
+		const F val = y[i];
+		norm += std::fabs(val);
+		y[i] = (F) ((val > 0) - (val < 0));
+	}
+	return norm;
 }
 
+// \|x\|_2 from norms of chunks, which are computed by BLAS
 template<typename F>
-void vector_sgn(F * y, unsigned int n) { // compute y=sgn(y)
+F vector_l2_norm(const F * x, const unsigned int n,
+		const unsigned int threads = 1) {
+	if (threads <= 1)
+		return cblas_l2_norm(n, x, 1);
+	F squares = 0;
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for num_threads(threads) reduction(+:squares)
 #endif
-	for (unsigned int i = 0; i < n; i++) {
-		y[i] = sgn(y[i]);
+	for (unsigned int t = 0; t < threads; t++) {
+		const unsigned int begin = SolverStructures::vector_chunk(n, threads, t);
+		const F norm = cblas_l2_norm(
+				SolverStructures::vector_chunk(n, threads, t + 1) - begin,
+				&x[begin], 1);
+		squares += norm * norm;
 	}
+	return sqrt(squares);
 }
 
 void mySort(double * x, const unsigned int length,
@@ -88,60 +119,180 @@ void mySort(float * x, const unsigned int length,
 	sort(myvector.begin(), myvector.end(), abs_value_comparator<float>);
 }
 
+// absX = |x|, with threads > 1 split into chunks across threads
 template<typename F>
-F find_hard_treshHolding_parameter_with_sorting(F * x,
-		const unsigned int length, const unsigned int k,
-		std::vector<F>& myvector) {
-	//	For most real-world cases, parallel sort would be optimal algorithm. However, with higher concurrency levels, larger data-set size or heavier comparator/hasher complexity, parallel buffered sort or parallel radix sort may perform magnitudes better.
-	mySort(x, length, myvector);
-	return abs(myvector[length - k]);
+void vector_abs(const F * x, F * absX, const unsigned int length,
+		const unsigned int threads = 1) {
+	if (threads > 1) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads)
+#endif
+		for (unsigned int t = 0; t < threads; t++) {
+			const unsigned int begin = SolverStructures::vector_chunk(length,
+					threads, t);
+			vector_abs(&x[begin], &absX[begin],
+					SolverStructures::vector_chunk(length, threads, t + 1)
+							- begin);
+		}
+		return;
+	}
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+	for (unsigned int i = 0; i < length; i++) {
+		absX[i] = std::fabs(x[i]);
+	}
 }
 
+/*
+ * Returns k-th largest |x_i| (k >= 1). |x| is copied into "myvector" (resized only if
+ * it is too short) and the k-th element is found by std::nth_element
+ * (introselect), i.e. expected O(length) time and no allocations.
+ */
 template<typename F>
-F find_hard_treshHolding_parameter_without_sorting(F * x,
+F find_hard_treshHolding_parameter_with_selection(const F * x,
 		const unsigned int length, const unsigned int k,
-		std::vector<F>& myvector) {
-	set<data_for_sorted_map<F>, data_for_sorted_map_comp<F> > data;
-	for (unsigned int j = 0; j < k; j++) {
-		data.insert(data_for_sorted_map<F>(abs(x[j]), j));
+		std::vector<F>& myvector, const unsigned int threads = 1) {
+	if (myvector.size() < length)
+		myvector.resize(length);
+	F* absX = &myvector[0];
+	vector_abs(x, absX, length, threads);
+	if (k >= length) {
+		return *std::min_element(absX, absX + length);
 	}
-	F thresh = 0;
-	for (unsigned int j = k; j < length; j++) {
-		F tmp = abs(x[j]);
-		thresh = data.rbegin()->value;
-		if (tmp > thresh) {
-			data.erase(*data.rbegin());
-			data.insert(data_for_sorted_map<F>(tmp, j));
+	std::nth_element(absX, absX + (length - k), absX + length);
+	return absX[length - k];
+}
+
+/*
+ * Counting pass of T_k: entries with |x_i| above and equal to the threshold
+ * and sum of squares of those above it.
+ */
+template<typename F>
+void count_above_threshold(const F * x, const unsigned int length,
+		const F treshHold, unsigned int& greater, unsigned int& equal,
+		F& greaterSquares, const unsigned int threads = 1) {
+	unsigned int greaterCount = 0;
+	unsigned int equalCount = 0;
+	F squares = 0;
+	if (threads > 1) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) reduction(+:greaterCount,equalCount,squares)
+#endif
+		for (unsigned int t = 0; t < threads; t++) {
+			const unsigned int begin = SolverStructures::vector_chunk(length,
+					threads, t);
+			unsigned int chunkGreater;
+			unsigned int chunkEqual;
+			F chunkSquares;
+			count_above_threshold(&x[begin],
+					SolverStructures::vector_chunk(length, threads, t + 1)
+							- begin, treshHold, chunkGreater, chunkEqual,
+					chunkSquares);
+			greaterCount += chunkGreater;
+			equalCount += chunkEqual;
+			squares += chunkSquares;
+		}
+	} else {
+#ifdef _OPENMP
+#pragma omp simd reduction(+:greaterCount,equalCount,squares)
+#endif
+		for (unsigned int i = 0; i < length; i++) {
+			const F val = x[i];
+			const F absVal = std::fabs(val);
+			greaterCount += (absVal > treshHold);
+			equalCount += (absVal == treshHold);
+			squares += (absVal > treshHold) ? val * val : 0;
 		}
 	}
-	return data.rbegin()->value;
+	greater = greaterCount;
+	equal = equalCount;
+	greaterSquares = squares;
 }
 
+// x_i = x_i * scale if |x_i| >= threshold, 0 otherwise
 template<typename F>
-F k_hard_thresholding(F * x, const unsigned int length, const unsigned int k,
-		std::vector<F>& myvector,
-		SolverStructures::OptimizationSettings* optimizationSettings) {
-	F treshHold;
-	if (optimizationSettings->useSortForHardThresholding) {
-		treshHold = find_hard_treshHolding_parameter_with_sorting(x, length, k,
-				myvector);
-	} else {
-		treshHold = find_hard_treshHolding_parameter_without_sorting(x, length,
-				k, myvector);
+void keep_above_threshold(F * x, const unsigned int length, const F treshHold,
+		const F scale, const unsigned int threads = 1) {
+	if (threads > 1) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads)
+#endif
+		for (unsigned int t = 0; t < threads; t++) {
+			const unsigned int begin = SolverStructures::vector_chunk(length,
+					threads, t);
+			keep_above_threshold(&x[begin],
+					SolverStructures::vector_chunk(length, threads, t + 1)
+							- begin, treshHold, scale);
+		}
+		return;
 	}
-	F norm = 0;
 #ifdef _OPENMP
-#pragma omp parallel for reduction(+:norm)
+#pragma omp simd
 #endif
 	for (unsigned int i = 0; i < length; i++) {
-		F val = x[i];
-		if (abs(val) < treshHold) {
+		const F val = x[i];
+		x[i] = (std::fabs(val) >= treshHold) ? val * scale : 0;
+	}
+}
+
+/*
+ * Hard thresholding x = T_k(x). Exactly min(k, length) largest entries (in
+ * absolute value) are kept; if there are ties at the threshold, entries with
+ * smaller index win, hence result does not depend on the number of threads.
+ *
+ * Returns \|T_k(x)\| (for k = 0, x is set to zero and 0 is returned). The
+ * norm is known after the counting pass (ties have |x_i| = threshold), so
+ * with "normalize" the result is divided by it in the same pass which writes
+ * it; "nnz" (if given) receives its cardinality.
+ * The passes use executionPolicy.threadsWithinVector threads, the selection
+ * of the threshold is serial.
+ */
+template<typename F>
+F k_hard_thresholding(F * x, const unsigned int length, const unsigned int k,
+		std::vector<F>& myvector,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		const bool normalize = false, unsigned int* nnz = NULL) {
+	const unsigned int threads =
+			optimizationSettings->executionPolicy.threadsWithinVector(length);
+	if (k == 0 || length == 0) {
+		for (unsigned int i = 0; i < length; i++)
 			x[i] = 0;
-		} else {
-			norm += val * val;
+		if (nnz != NULL)
+			*nnz = 0;
+		return 0;
+	}
+	const F treshHold = find_hard_treshHolding_parameter_with_selection(x,
+			length, k, myvector, threads);
+	unsigned int greater;
+	unsigned int equal;
+	F greaterSquares;
+	count_above_threshold(x, length, treshHold, greater, equal, greaterSquares,
+			threads);
+	const unsigned int ties = std::min(equal, k - std::min(greater, k));
+	const F norm = sqrt(greaterSquares + ties * treshHold * treshHold);
+	const F scale = (normalize && norm > 0) ? 1 / norm : 1;
+	if (nnz != NULL)
+		*nnz = greater + ((treshHold > 0) ? ties : 0);
+	if (greater + equal <= k) {
+		// no ties to break, keep everything >= threshold
+		keep_above_threshold(x, length, treshHold, scale, threads);
+	} else {
+		unsigned int remaining = ties;
+		for (unsigned int i = 0; i < length; i++) {
+			const F val = x[i];
+			const F absVal = std::fabs(val);
+			if (absVal > treshHold) {
+				x[i] = val * scale;
+			} else if (absVal == treshHold && remaining > 0) {
+				remaining--;
+				x[i] = val * scale;
+			} else {
+				x[i] = 0;
+			}
 		}
 	}
-	return sqrt(norm);
+	return norm;
 }
 
 template<typename F>
@@ -157,10 +308,15 @@ F compute_V_value(F*x, const unsigned int length, F lambda,
 	return lambda * sqrt(constrain + 0.0) + sqrt(value);
 }
 
-// Soft treshholding  x_i = (|x_i| - w)_+ sgn(x_i)
+/*
+ * Reference implementation of the soft-thresholding parameter: |x| is fully
+ * sorted and the breakpoints are scanned from the largest one, solving a
+ * quadratic equation on every interval. O(length log length).
+ */
 template<typename F>
-F soft_thresholding(F * x, const unsigned int length,
-		const unsigned int constrain, std::vector<F>& myvector,
+F find_soft_treshHolding_parameter_with_sorting(F * x,
+		const unsigned int length, const unsigned int constrain,
+		std::vector<F>& myvector,
 		SolverStructures::OptimizationSettings* optimizationSettings) {
 	F sq_constr = sqrt(constrain + 0.0);
 	mySort(x, length, myvector);
@@ -223,34 +379,252 @@ F soft_thresholding(F * x, const unsigned int length,
 		printf("Problem detected!  %f < %f < %f  \n",lambda_Low,w,lambda_High);
 	}
 #endif
-	F norm = 0;
+	return w;
+}
+
+/*
+ * absX = |x|, sum = \|x\|_1, sum2 = \|x\|_2^2
+ */
+template<typename F>
+void vector_abs_and_sums(const F * x, F * absX, const unsigned int length,
+		F& sum, F& sum2, const unsigned int threads = 1) {
+	F sum_abs_x = 0;
+	F sum_abs_x2 = 0;
+	if (threads > 1) {
 #ifdef _OPENMP
-#pragma omp parallel for reduction(+:norm)
-	for (unsigned int i = 0; i < length; i++) {
-		F tmp = x[i];
-		F tmp2 = abs(tmp) - w;
-		if (tmp2 > 0) {
-			const F val = tmp2 * sgn(tmp);
-			x[i]=val;
-			norm += val * val;
+#pragma omp parallel for num_threads(threads) reduction(+:sum_abs_x,sum_abs_x2)
+#endif
+		for (unsigned int t = 0; t < threads; t++) {
+			const unsigned int begin = SolverStructures::vector_chunk(length,
+					threads, t);
+			F chunkSum;
+			F chunkSum2;
+			vector_abs_and_sums(&x[begin], &absX[begin],
+					SolverStructures::vector_chunk(length, threads, t + 1)
+							- begin, chunkSum, chunkSum2);
+			sum_abs_x += chunkSum;
+			sum_abs_x2 += chunkSum2;
+		}
+	} else {
+#ifdef _OPENMP
+#pragma omp simd reduction(+:sum_abs_x,sum_abs_x2)
+#endif
+		for (unsigned int i = 0; i < length; i++) {
+			const F val = std::fabs(x[i]);
+			absX[i] = val;
+			sum_abs_x += val;
+			sum_abs_x2 += val * val;
+		}
+	}
+	sum = sum_abs_x;
+	sum2 = sum_abs_x2;
+}
+
+/*
+ * Soft-thresholding parameter w such that y = (|x| - w)_+ sgn(x) satisfies
+ * \|y\|_1 = sqrt(constrain) \|y\|_2 (w = 0 if x is already feasible).
+ *
+ * The ratio g(w) = \|(|x| - w)_+\|_1 / \|(|x| - w)_+\|_2 is non-increasing in w,
+ * hence the interval of breakpoints containing w can be found by quickselect:
+ * a pivot |x_p| is taken from the candidate set, g(|x_p|) is evaluated using
+ * sums of the already accepted elements plus those above the pivot, and one
+ * side of the partition is discarded. Expected O(length) time, |x| is
+ * partitioned in place in "myvector". The quadratic equation is solved only
+ * once, on the final interval.
+ */
+template<typename F>
+F find_soft_treshHolding_parameter_with_selection(const F * x,
+		const unsigned int length, const unsigned int constrain,
+		std::vector<F>& myvector, const unsigned int threads = 1) {
+	if (myvector.size() < length)
+		myvector.resize(length);
+	F* absX = &myvector[0];
+	F sum_abs_x;
+	F sum_abs_x2;
+	vector_abs_and_sums(x, absX, length, sum_abs_x, sum_abs_x2, threads);
+	const F s = constrain;
+	const F sq_constr = sqrt(s);
+	if (sum_abs_x2 == 0 || sum_abs_x <= sq_constr * sqrt(sum_abs_x2))
+		return 0;
+	// elements accepted as active (strictly above w)
+	F activeSum = 0;
+	F activeSum2 = 0;
+	unsigned int activeCount = 0;
+	// w lies in [lambda_Low, lambda_High]
+	F lambda_Low = 0;
+	F lambda_High = 0;
+	unsigned int lo = 0;
+	unsigned int hi = length;
+	while (lo < hi) {
+		const F pivot = absX[lo + (hi - lo) / 2];
+		// three-way partition of [lo,hi): > pivot | == pivot | < pivot
+		unsigned int gt = lo;
+		unsigned int eq = lo;
+		unsigned int lt = hi;
+		F greaterSum = 0;
+		F greaterSum2 = 0;
+		while (eq < lt) {
+			const F val = absX[eq];
+			if (val > pivot) {
+				greaterSum += val;
+				greaterSum2 += val * val;
+				absX[eq] = absX[gt];
+				absX[gt] = val;
+				gt++;
+				eq++;
+			} else if (val < pivot) {
+				lt--;
+				absX[eq] = absX[lt];
+				absX[lt] = val;
+			} else {
+				eq++;
+			}
+		}
+		const unsigned int equal = eq - gt;
+		const F sum1 = activeSum + greaterSum;
+		const F sum2 = activeSum2 + greaterSum2;
+		const unsigned int count = activeCount + (gt - lo);
+		// g(pivot); elements equal to pivot do not contribute
+		bool wBelowPivot = true;
+		if (count > 0) {
+			const F denominator = sum2 - 2 * pivot * sum1
+					+ count * pivot * pivot;
+			wBelowPivot = denominator <= 0
+					|| (sum1 - count * pivot) < sq_constr * sqrt(denominator);
+		}
+		if (wBelowPivot) {
+			// everything >= pivot is active
+			activeSum = sum1 + equal * pivot;
+			activeSum2 = sum2 + equal * pivot * pivot;
+			activeCount = count + equal;
+			lambda_High = pivot;
+			lo = lt;
 		} else {
-			x[i]=0;
+			// everything <= pivot is inactive
+			lambda_Low = pivot;
+			hi = gt;
 		}
 	}
-#else
+	// (sum - k w)^2 = s (sum2 - 2 w sum + k w^2) on [lambda_Low, lambda_High]
+	const F k = activeCount;
+	const F a = k * (k - s);
+	const F b = 2 * activeSum * (s - k);
+	const F c = activeSum * activeSum - s * activeSum2;
+	F w;
+	if (a == 0) {
+		w = -c / b;
+	} else {
+		const F discriminant = sqrt(std::max(b * b - 4 * a * c, (F) 0));
+		w = (-b - discriminant) / (2 * a);
+		const F w2 = (-b + discriminant) / (2 * a);
+		// prefer the root in the interval with (sum - k w) >= 0
+		if (!(w >= lambda_Low && w <= lambda_High
+				&& activeSum - k * w >= 0))
+			w = w2;
+	}
+	if (!(w >= lambda_Low))
+		w = lambda_Low;
+	if (!(w <= lambda_High))
+		w = lambda_High;
+	return w;
+}
+
+// \|(|x| - w)_+\|_2^2, read-only
+template<typename F>
+F soft_threshold_squares(const F * x, const unsigned int length, const F w,
+		const unsigned int threads = 1) {
+	F squares = 0;
+	if (threads > 1) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) reduction(+:squares)
+#endif
+		for (unsigned int t = 0; t < threads; t++) {
+			const unsigned int begin = SolverStructures::vector_chunk(length,
+					threads, t);
+			squares += soft_threshold_squares(&x[begin],
+					SolverStructures::vector_chunk(length, threads, t + 1)
+							- begin, w);
+		}
+		return squares;
+	}
+#ifdef _OPENMP
+#pragma omp simd reduction(+:squares)
+#endif
 	for (unsigned int i = 0; i < length; i++) {
-		F tmp = x[i];
-		F tmp2 = abs(tmp) - w;
-		if (tmp2 > 0) {
-			const F val = tmp2 * sgn(tmp);
-			x[i] = val;
-			norm += val * val;
-		} else {
-			x[i] = 0;
+		const F shrunk = std::fabs(x[i]) - w;
+		squares += (shrunk > 0) ? shrunk * shrunk : 0;
+	}
+	return squares;
+}
+
+/*
+ * x_i = (|x_i| - w)_+ sgn(x_i) * scale, returns \|(|x| - w)_+\|_2^2 and
+ * cardinality of the result in "nnz"
+ */
+template<typename F>
+F soft_threshold_column(F * x, const unsigned int length, const F w,
+		const F scale, unsigned int& nnz, const unsigned int threads = 1) {
+	F squares = 0;
+	unsigned int count = 0;
+	if (threads > 1) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) reduction(+:squares,count)
+#endif
+		for (unsigned int t = 0; t < threads; t++) {
+			const unsigned int begin = SolverStructures::vector_chunk(length,
+					threads, t);
+			unsigned int chunkCount;
+			squares += soft_threshold_column(&x[begin],
+					SolverStructures::vector_chunk(length, threads, t + 1)
+							- begin, w, scale, chunkCount);
+			count += chunkCount;
 		}
+		nnz = count;
+		return squares;
 	}
+#ifdef _OPENMP
+#pragma omp simd reduction(+:squares,count)
 #endif
-	return sqrt(norm);
+	for (unsigned int i = 0; i < length; i++) {
+		// (|x_i| - w)_+ sgn(x_i) = x_i - clip(x_i, -w, w), vectorized selects
+		const F val = x[i];
+		const F upper = (val < w) ? val : w;
+		const F shrunk = val - ((upper > -w) ? upper : -w);
+		squares += shrunk * shrunk;
+		count += (shrunk != 0);
+		x[i] = shrunk * scale;
+	}
+	nnz = count;
+	return squares;
+}
+
+/*
+ * Soft treshholding  x_i = (|x_i| - w)_+ sgn(x_i), returns its norm. With
+ * "normalize" the norm is summed by a read-only pass first and the result is
+ * divided by it in the pass which writes it; "nnz" (if given) receives its
+ * cardinality. The passes use executionPolicy.threadsWithinVector threads.
+ */
+template<typename F>
+F soft_thresholding(F * x, const unsigned int length,
+		const unsigned int constrain, std::vector<F>& myvector,
+		SolverStructures::OptimizationSettings* optimizationSettings,
+		const bool normalize = false, unsigned int* nnz = NULL) {
+	const unsigned int threads =
+			optimizationSettings->executionPolicy.threadsWithinVector(length);
+	const F w = find_soft_treshHolding_parameter_with_selection(x, length,
+			constrain, myvector, threads);
+	F norm = 0;
+	F scale = 1;
+	if (normalize) {
+		norm = sqrt(soft_threshold_squares(x, length, w, threads));
+		scale = (norm > 0) ? 1 / norm : 1;
+	}
+	unsigned int count;
+	const F squares = soft_threshold_column(x, length, w, scale, count,
+			threads);
+	if (nnz != NULL)
+		*nnz = count;
+	return normalize ? norm : sqrt(squares);
 }
 
 #endif /* TRESH_FUNCTIONS_H_ */
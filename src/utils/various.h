@@ -28,7 +28,9 @@ public:
 	ValueCoordinateHolder() {
 		idx=0;
 		val = 0;
+		prev_val = 0;
 		tmp=0;
+		current_error = 0;
 		done=false;
 	}
 
@@ -50,15 +52,15 @@ template<typename T> T myabs(T val) {
 }
 
 
+// serial, it is called within loops over columns
 template<typename F>
 unsigned int vector_get_nnz(const F * x,unsigned int size) {
 	unsigned int nnz = 0;
 #ifdef _OPENMP
-#pragma omp parallel for reduction(+:nnz)
+#pragma omp simd reduction(+:nnz)
 #endif
 	for (unsigned int i = 0; i < size; i++) {
-		if (x[i] != 0)
-			nnz++;
+		nnz += (x[i] != 0);
 	}
 	return nnz;
 }